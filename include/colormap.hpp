@@ -3,173 +3,158 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <vector>
 
+// Un stop del colormap: posición en [0,1] y color RGB
+struct ColorStop {
+  double pos;
+  std::array<double, 3> rgb;
+};
+
+// El colormap se evalúa con una tabla de kLutSize colores ARGB32 opacos
+// (0xffRRGGBB, el formato de Cairo y del rasterizador por software): colorear
+// un grano es una multiplicación y una lectura de la tabla. Las tablas de los
+// colormaps incluidos se generan en tiempo de compilación.
 class Colormap {
 public:
-  // Constructor: recibe stops {pos,[r,g,b]}
-  Colormap(const std::vector<std::pair<double, std::array<double, 3>>> &stops)
-      : stops(stops) {
-    std::sort(this->stops.begin(), this->stops.end(),
-              [](auto &a, auto &b) { return a.first < b.first; });
-  }
+  static constexpr size_t kLutSize = 4096;
+  using Lut = std::array<uint32_t, kLutSize>;
+
+  // Constructor: recibe stops {pos,[r,g,b]}; la tabla se arma al construir
+  Colormap(const std::vector<std::pair<double, std::array<double, 3>>> &stops);
+
+  // Tabla ya generada (la de los colormaps incluidos, que es estática)
+  explicit Colormap(const Lut &lut) : lut_(&lut), hash_(hashOf(lut)) {}
 
   std::array<double, 3> operator()(double value, double vmin,
                                    double vmax) const {
-    double t = (value - vmin) / (vmax - vmin + 1e-12);
-    t = std::clamp(t, 0.0, 1.0);
-
-    // buscar intervalo
-    for (size_t i = 1; i < stops.size(); i++) {
-      if (t <= stops[i].first) {
-        double t0 = stops[i - 1].first, t1 = stops[i].first;
-        double u = (t - t0) / (t1 - t0 + 1e-12);
-        auto c0 = stops[i - 1].second;
-        auto c1 = stops[i].second;
-        return {(1 - u) * c0[0] + u * c1[0], (1 - u) * c0[1] + u * c1[1],
-                (1 - u) * c0[2] + u * c1[2]};
-      }
-    }
-    return stops.back().second;
+    return unpack(packed(value, vmin, vmax));
+  }
+
+  // Color ARGB32 de `value`
+  uint32_t packed(double value, double vmin, double vmax) const {
+    return (*lut_)[index(value, vmin, vmax)];
+  }
+
+  // Entrada de la tabla que corresponde a `value` (valores fuera de
+  // [vmin,vmax] se recortan a los extremos)
+  size_t index(double value, double vmin, double vmax) const {
+    return level(value, vmin, scale(vmin, vmax));
+  }
+
+  // Colorea todos los valores de una vez: out[i] = packed(values[i], ...).
+  // `out` debe tener al menos values.size() elementos.
+  void mapColors(std::span<const double> values, double vmin, double vmax,
+                 uint32_t *out) const;
+
+  // Igual que mapColors pero devuelve el nivel: out[i] = index(values[i], ...)
+  void mapLevels(std::span<const double> values, double vmin, double vmax,
+                 uint16_t *out) const;
+
+  const Lut &lut() const { return *lut_; }
+
+  // Huella del contenido de la tabla: la misma para dos Colormap con los
+  // mismos colores, aunque sean tablas distintas (para claves de caché)
+  uint64_t hash() const { return hash_; }
+
+  static std::array<double, 3> unpack(uint32_t argb) {
+    return {((argb >> 16) & 0xff) / 255.0, ((argb >> 8) & 0xff) / 255.0,
+            (argb & 0xff) / 255.0};
   }
 
 private:
-  std::vector<std::pair<double, std::array<double, 3>>> stops;
+  static double scale(double vmin, double vmax) {
+    return (kLutSize - 1) / (vmax - vmin + 1e-12);
+  }
+  // Un NaN va al extremo superior, como en la búsqueda lineal original
+  static size_t level(double value, double vmin, double scale) {
+    constexpr double top = kLutSize - 1;
+    double t = (value - vmin) * scale + 0.5;
+    t = t < 0.0 ? 0.0 : (t < top ? t : top);
+    return static_cast<size_t>(t);
+  }
+
+  static uint64_t hashOf(const Lut &lut);
+
+  std::shared_ptr<const Lut> owned_; // sólo para stops dados en ejecución
+  const Lut *lut_;
+  uint64_t hash_;
 };
 
-// Colormaps de ejemplo:
-inline Colormap viridis() {
-  return Colormap({
-    {0.000, {0.267, 0.004, 0.329}},
-    {0.111, {0.283, 0.141, 0.458}},
-    {0.222, {0.254, 0.265, 0.530}},
-    {0.333, {0.207, 0.372, 0.553}},
-    {0.444, {0.153, 0.468, 0.557}},
-    {0.556, {0.122, 0.543, 0.544}},
-    {0.667, {0.173, 0.622, 0.494}},
-    {0.778, {0.337, 0.706, 0.414}},
-    {0.889, {0.592, 0.776, 0.318}},
-    {1.000, {0.993, 0.906, 0.144}}
-  });
-}
+namespace cmap_detail {
 
-inline Colormap inferno() {
-  return Colormap({
-    {0.000, {0.002, 0.000, 0.014}},
-    {0.111, {0.087, 0.016, 0.232}},
-    {0.222, {0.245, 0.033, 0.206}},
-    {0.333, {0.395, 0.068, 0.349}},
-    {0.444, {0.552, 0.105, 0.388}},
-    {0.556, {0.710, 0.167, 0.352}},
-    {0.667, {0.847, 0.257, 0.262}},
-    {0.778, {0.934, 0.391, 0.210}},
-    {0.889, {0.976, 0.568, 0.253}},
-    {1.000, {0.988, 0.998, 0.645}}
-  });
+constexpr uint32_t channel(double v) {
+  return static_cast<uint32_t>((v < 0.0 ? 0.0 : v > 1.0 ? 1.0 : v) * 255.0 +
+                               0.5);
 }
 
-inline Colormap RdYlBu() {
-  return Colormap({
-    {0.000, {0.647, 0.000, 0.149}},
-    {0.111, {0.843, 0.188, 0.153}},
-    {0.222, {0.957, 0.427, 0.263}},
-    {0.333, {0.992, 0.682, 0.380}},
-    {0.444, {0.998, 0.851, 0.561}},
-    {0.556, {0.878, 0.953, 0.973}},
-    {0.667, {0.670, 0.851, 0.914}},
-    {0.778, {0.455, 0.678, 0.820}},
-    {0.889, {0.271, 0.459, 0.706}},
-    {1.000, {0.192, 0.212, 0.584}}
-  });
+constexpr uint32_t pack(const std::array<double, 3> &rgb) {
+  return 0xff000000u | channel(rgb[0]) << 16 | channel(rgb[1]) << 8 |
+         channel(rgb[2]);
 }
 
-inline Colormap Greens() {
-  return Colormap({
-    {0.000, {0.969, 0.988, 0.961}},
-    {0.111, {0.898, 0.961, 0.878}},
-    {0.222, {0.784, 0.925, 0.753}},
-    {0.333, {0.631, 0.851, 0.608}},
-    {0.444, {0.455, 0.769, 0.463}},
-    {0.556, {0.255, 0.671, 0.306}},
-    {0.667, {0.137, 0.545, 0.271}},
-    {0.778, {0.000, 0.427, 0.173}},
-    {0.889, {0.000, 0.267, 0.106}},
-    {1.000, {0.000, 0.137, 0.055}}
-  });
+// Interpolación lineal entre los stops (ordenados por posición), recorriéndolos
+// una sola vez a lo largo de la tabla
+constexpr Colormap::Lut makeLut(std::span<const ColorStop> stops) {
+  Colormap::Lut lut{};
+  size_t seg = 1;
+  for (size_t i = 0; i < lut.size(); i++) {
+    const double t = static_cast<double>(i) / (Colormap::kLutSize - 1);
+    while (seg < stops.size() && t > stops[seg].pos)
+      seg++;
+    if (seg == stops.size()) {
+      lut[i] = pack(stops.back().rgb);
+      continue;
+    }
+    const ColorStop &s0 = stops[seg - 1], &s1 = stops[seg];
+    const double u = (t - s0.pos) / (s1.pos - s0.pos + 1e-12);
+    lut[i] = pack({(1 - u) * s0.rgb[0] + u * s1.rgb[0],
+                   (1 - u) * s0.rgb[1] + u * s1.rgb[1],
+                   (1 - u) * s0.rgb[2] + u * s1.rgb[2]});
+  }
+  return lut;
 }
 
-inline Colormap Reds() {
-  return Colormap({
-    {0.000, {1.000, 0.961, 0.941}},
-    {0.111, {0.996, 0.878, 0.824}},
-    {0.222, {0.988, 0.733, 0.631}},
-    {0.333, {0.988, 0.573, 0.447}},
-    {0.444, {0.984, 0.416, 0.290}},
-    {0.556, {0.937, 0.231, 0.173}},
-    {0.667, {0.796, 0.094, 0.114}},
-    {0.778, {0.647, 0.059, 0.082}},
-    {0.889, {0.404, 0.000, 0.051}},
-    {1.000, {0.220, 0.000, 0.031}}
-  });
-}
+// Tablas de los colormaps incluidos (generadas al compilar colormap.cpp)
+extern const Colormap::Lut kViridisLut;
+extern const Colormap::Lut kInfernoLut;
+extern const Colormap::Lut kRdYlBuLut;
+extern const Colormap::Lut kGreensLut;
+extern const Colormap::Lut kRedsLut;
+extern const Colormap::Lut kWinterLut;
+extern const Colormap::Lut kAutumnLut;
+extern const Colormap::Lut kBluesLut;
+extern const Colormap::Lut kHotLut;
 
-inline Colormap winter() {
-  return Colormap({
-    {0.000, {0.000, 0.000, 1.000}},
-    {0.111, {0.000, 0.111, 0.944}},
-    {0.222, {0.000, 0.222, 0.889}},
-    {0.333, {0.000, 0.333, 0.833}},
-    {0.444, {0.000, 0.444, 0.778}},
-    {0.556, {0.000, 0.556, 0.722}},
-    {0.667, {0.000, 0.667, 0.667}},
-    {0.778, {0.000, 0.778, 0.611}},
-    {0.889, {0.000, 0.889, 0.556}},
-    {1.000, {0.000, 1.000, 0.500}}
-  });
-}
+} // namespace cmap_detail
 
-inline Colormap autumn() {
-  return Colormap({
-    {0.000, {1.000, 0.000, 0.000}},
-    {0.111, {1.000, 0.111, 0.000}},
-    {0.222, {1.000, 0.222, 0.000}},
-    {0.333, {1.000, 0.333, 0.000}},
-    {0.444, {1.000, 0.444, 0.000}},
-    {0.556, {1.000, 0.556, 0.000}},
-    {0.667, {1.000, 0.667, 0.000}},
-    {0.778, {1.000, 0.778, 0.000}},
-    {0.889, {1.000, 0.889, 0.000}},
-    {1.000, {1.000, 1.000, 0.000}}
-  });
+inline Colormap::Colormap(
+    const std::vector<std::pair<double, std::array<double, 3>>> &stops) {
+  std::vector<ColorStop> sorted;
+  for (const auto &[pos, rgb] : stops)
+    sorted.push_back({pos, rgb});
+  std::sort(sorted.begin(), sorted.end(),
+            [](auto &a, auto &b) { return a.pos < b.pos; });
+  owned_ = std::make_shared<const Lut>(cmap_detail::makeLut(sorted));
+  lut_ = owned_.get();
+  hash_ = hashOf(*lut_);
 }
 
-// Colormaps secuenciales adicionales
-inline Colormap Blues() {
-  return Colormap({
-    {0.000, {0.969, 0.984, 1.000}},
-    {0.111, {0.871, 0.922, 0.969}},
-    {0.222, {0.776, 0.859, 0.937}},
-    {0.333, {0.619, 0.792, 0.882}},
-    {0.444, {0.420, 0.682, 0.839}},
-    {0.556, {0.259, 0.573, 0.776}},
-    {0.667, {0.129, 0.443, 0.710}},
-    {0.778, {0.031, 0.318, 0.612}},
-    {0.889, {0.031, 0.188, 0.420}},
-    {1.000, {0.015, 0.094, 0.235}}
-  });
-}
+// Colormaps de ejemplo:
+inline Colormap viridis() { return Colormap(cmap_detail::kViridisLut); }
+inline Colormap inferno() { return Colormap(cmap_detail::kInfernoLut); }
+inline Colormap RdYlBu() { return Colormap(cmap_detail::kRdYlBuLut); }
+inline Colormap Greens() { return Colormap(cmap_detail::kGreensLut); }
+inline Colormap Reds() { return Colormap(cmap_detail::kRedsLut); }
+inline Colormap winter() { return Colormap(cmap_detail::kWinterLut); }
+inline Colormap autumn() { return Colormap(cmap_detail::kAutumnLut); }
 
-inline Colormap hot() {
-  return Colormap({
-    {0.000, {0.041, 0.000, 0.000}},
-    {0.143, {0.504, 0.000, 0.000}},
-    {0.286, {1.000, 0.251, 0.000}},
-    {0.429, {1.000, 0.504, 0.000}},
-    {0.571, {1.000, 0.757, 0.000}},
-    {0.714, {1.000, 1.000, 0.251}},
-    {0.857, {1.000, 1.000, 0.504}},
-    {1.000, {1.000, 1.000, 1.000}}
-  });
-}
+// Colormaps secuenciales adicionales
+inline Colormap Blues() { return Colormap(cmap_detail::kBluesLut); }
+inline Colormap hot() { return Colormap(cmap_detail::kHotLut); }
 
 #endif
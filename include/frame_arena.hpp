@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Arena por frame: un memory_resource de asignación lineal que se rebobina
+//
+// Todo lo que un frame necesita (columnas de granos, vértices, filas de
+// valores, puntos del histograma, temporales del parseo) se pide a la arena
+// mediante contenedores std::pmr. Liberar es gratis, y `rewind()` deja la
+// memoria lista para el frame siguiente sin devolverla al sistema: tras los
+// primeros frames el procesamiento no vuelve a tocar el heap global, y los
+// hilos no compiten por el lock de malloc.
+class FrameArena final : public std::pmr::memory_resource {
+public:
+  explicit FrameArena(size_t blockSize = size_t(1) << 20);
+  ~FrameArena() override;
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  // Marca toda la memoria como libre. Los contenedores construidos sobre la
+  // arena tienen que haberse destruido antes. Si el frame anterior no entró
+  // en un solo bloque, los bloques se funden en uno del tamaño total.
+  void rewind();
+
+  size_t capacity() const; // bytes reservados
+  size_t used() const;     // bytes entregados desde el último rewind
+
+private:
+  struct Block {
+    std::byte *data;
+    size_t size;
+  };
+
+  void *do_allocate(size_t bytes, size_t align) override;
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  Block newBlock(size_t bytes);
+
+  std::vector<Block> blocks_;
+  size_t current_ = 0; // bloque en uso
+  size_t offset_ = 0;  // primer byte libre de blocks_[current_]
+  size_t blockSize_;
+};
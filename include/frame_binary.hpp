@@ -0,0 +1,76 @@
+#pragma once
+#include "grain_store.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Formato binario columnar de frames (.gfb)
+//
+// Guarda lo mismo que producen los lectores de texto (.xy + .sxy/.ve) pero
+// como columnas contiguas, de modo que un frame se carga con un único mmap
+// y memcpy por columna, sin tokenizar texto. Es independiente de la
+// propiedad, el colormap y los límites: se convierte una vez y se reutiliza.
+//
+// Layout (little endian, cada sección alineada a 64 bytes):
+//   Header | gid | type | nv | vtxOffset | vx | vy | cx | cy | radius |
+//   sxy.gid | sxy.offset | sxy.values | ve.gid | ve.offset | ve.values
+
+// Filas crudas de un archivo de valores (.sxy o .ve) en formato CSR
+struct ValueColumns {
+  std::pmr::vector<int32_t> gid;
+  std::pmr::vector<uint32_t> offset; // fila i en values[offset[i], offset[i+1])
+  std::pmr::vector<double> values;
+
+  explicit ValueColumns(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : gid(mem), offset(mem), values(mem) {}
+
+  size_t rows() const { return gid.size(); }
+  bool empty() const { return gid.empty(); }
+};
+
+// Columnas crudas de un .xy, en el orden del archivo
+struct FrameColumns {
+  std::pmr::vector<int32_t> gid;
+  std::pmr::vector<int32_t> type;
+  std::pmr::vector<int32_t> nv;
+  std::pmr::vector<uint32_t> vtxOffset; // vértices de la fila i en [o[i], o[i+1])
+  std::pmr::vector<double> vx, vy;      // vértices de polígonos y paredes
+  std::pmr::vector<double> cx, cy, radius; // centro y radio (solo círculos)
+
+  ValueColumns sxy; // valores del .sxy (vacío si no existía)
+  ValueColumns ve;  // valores del .ve (vacío si no existía)
+
+  explicit FrameColumns(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : gid(mem), type(mem), nv(mem), vtxOffset(mem), vx(mem), vy(mem),
+        cx(mem), cy(mem), radius(mem), sxy(mem), ve(mem) {}
+
+  size_t size() const { return gid.size(); }
+};
+
+namespace FrameBinary {
+
+inline constexpr const char *extension = ".gfb";
+
+// Escribe las columnas en `filename`. Devuelve false si falla la escritura.
+bool write(const std::string &filename, const FrameColumns &cols);
+
+// Lee un .gfb completo. Devuelve false si no existe o está corrupto.
+bool read(const std::string &filename, FrameColumns &cols);
+bool read(const MappedFile &file, const std::string &filename,
+          FrameColumns &cols);
+
+// true si el frame trae los valores que necesita `property`
+bool hasValuesFor(const FrameColumns &cols, const std::string &property);
+
+// Construye los granos calculando `property` a partir de los valores
+// (.sxy para presión, .ve para energía cinética y velocidad)
+GrainStore buildGrains(const FrameColumns &cols, const std::string &property);
+// Igual, agregando a `out` (que conserva su memory_resource)
+void buildGrains(const FrameColumns &cols, const std::string &property,
+                 GrainStore &out);
+
+} // namespace FrameBinary
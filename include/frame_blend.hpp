@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Persistencia temporal: cada frame se mezcla con los anteriores, como los
+// filtros tblend/tmix que usaba doVideo.sh
+//
+//   salida = (1 - opacity) * actual + opacity * sum(w_i * f_i) / sum(w_i)
+//
+// con f_i los últimos `frames` frames (sin mezclar, el último es el actual) y
+// los pesos del más viejo al más nuevo, como en tmix. frames = 2, pesos
+// "1 1" y opacidad O equivale a tblend=all_mode=average:all_opacity=O;
+// opacidad 1 equivale a tmix=frames=K:weights=....
+struct PersistOptions {
+  int frames = 1;              // 1 = sin persistencia
+  std::vector<double> weights; // vacío = todos 1; si faltan se repite el último
+  double opacity = 1.0;
+
+  bool enabled() const { return frames > 1; }
+
+  // "1 2 1" -> {1, 2, 1}; false si hay algo que no es un número >= 0 o
+  // todos son 0
+  static bool parseWeights(const std::string &text,
+                           std::vector<double> &weights);
+};
+
+// Anillo con los últimos frames renderizados (frames - 1 anteriores al
+// actual) y la mezcla entre ellos. Los frames deben llegar en orden; la
+// mezcla va en punto fijo (pesos en 1/256) con AVX2 o SSE2 según cómo se
+// compile, escalar si no.
+class FrameBlender {
+public:
+  FrameBlender(const PersistOptions &options, int width, int height);
+
+  // Guarda el frame ARGB32 en el anillo y lo reemplaza por la mezcla
+  void blend(uint32_t *data, int stride);
+
+private:
+  // Pesos en 1/256 (suman 256) de los `sources` frames disponibles, del
+  // más viejo al actual
+  void weightsFor(size_t sources);
+
+  PersistOptions options_;
+  int width_, height_;
+  std::vector<std::vector<uint32_t>> ring_; // frames anteriores, sin mezclar
+  size_t head_ = 0;                         // próximo lugar a reemplazar
+  size_t count_ = 0;                        // lugares ocupados
+  std::vector<uint16_t> q_;                 // pesos en 1/256
+  std::vector<const unsigned char *> rows_; // fila de cada frame a mezclar
+  std::vector<uint32_t> row_;               // la fila actual sin mezclar
+};
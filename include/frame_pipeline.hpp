@@ -0,0 +1,167 @@
+#pragma once
+#include "colormap.hpp"
+#include "frame_blend.hpp"
+#include "frame_stream.hpp"
+#include "histogram_magnitude_2d.hpp"
+#include "histogram_series.hpp"
+#include "image_writer.hpp"
+#include "renderer.hpp"
+#include "run_manifest.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+template <typename T> class BoundedQueue;
+template <typename T> class PoolLease;
+class TiledRenderer;
+class ValueTable;
+
+// Un frame a procesar: archivos de entrada y PNG de salida
+struct FrameJob {
+  size_t index = 0;        // posición en el orden de los frames
+  std::string frameFile;   // .xy[.gz|.zst] o .gfb
+  std::string valuesFile;  // .sxy/.ve (con .gfb sólo entra en la huella)
+  std::string outFile;     // .png, .qoi o .ppm según RenderSettings::encode
+  std::vector<std::string> outputFiles; // uno por RenderSettings::outputs
+  std::string otherValuesFile; // el otro de .sxy/.ve, si alguna salida lo usa
+                               // (con .gfb siempre, sólo para la huella)
+  bool binary = false;
+  bool render = true;           // false: sólo aporta al histograma (PNG al día)
+  bool histogram = true;        // false: su aporte ya está en el checkpoint
+  bool write = true; // false: se renderiza sólo como frame anterior de la
+                     // persistencia (su imagen está al día)
+  InputFingerprint fingerprint; // huella de las entradas para el manifest
+};
+
+// Una salida más de cada frame, dibujada del mismo parseo que la principal
+// con su propia propiedad, colormap, rango, límites y tamaño. Sus imágenes
+// van a <out>/<name>/ con el mismo nombre que las principales.
+struct OutputSpec {
+  std::string name;
+  std::string property = "pressure";
+  std::string cmapName = "viridis";
+  Colormap cmap = viridis();
+  int width = 1000;
+  int height = 1000;
+  double xmin = -10.0, xmax = 10.0;
+  double ymin = -10.0, ymax = 20.0;
+  double valmin = 0.0, valmax = 1.0;
+
+  // Aplica "clave=valor" separados por espacios sobre los valores actuales:
+  // property, cmap, size=WxH, xylimits=xmin,xmax,ymin,ymax, vals=min,max.
+  // false (con el motivo en `error`) si algo no se entiende.
+  bool parse(const std::string &text, std::string &error);
+};
+
+// Parámetros de render comunes a todos los frames
+struct RenderSettings {
+  std::string property = "pressure";
+  int width = 1000;
+  int height = 1000;
+  double margin = 40.0;
+  double xmin = -10.0, xmax = 10.0;
+  double ymin = -10.0, ymax = 20.0;
+  double valmin = 0.0, valmax = 1.0;
+  std::string cmapName = "viridis";
+  Colormap cmap = viridis();
+  RenderBackend backend = RenderBackend::Cairo;
+  bool batched = false; // un cairo_fill por color en lugar de uno por grano
+  double lod = 0.0; // > 0: granos de radio menor (en píxeles) como huellas
+  EncodeOptions encode;  // formato de las imágenes de salida
+  StreamOptions stream;  // con path: un único flujo Y4M/RGB en lugar de imágenes
+  PersistOptions persist; // mezcla de cada frame con los anteriores
+  int tile = 0; // > 0: render por tiles de este lado (TiledRenderer), sólo PNG
+  // Salidas adicionales del mismo parseo (sin stream, persistencia ni tiles)
+  std::vector<OutputSpec> outputs;
+
+  // Estos parámetros con los de la salida adicional `k`
+  RenderSettings output(size_t k) const;
+
+  // Texto que identifica todo lo que cambia el PNG; su hash va al manifest
+  std::string signature() const;
+};
+
+// Hilos por etapa y profundidad de las colas entre etapas
+struct PipelineConfig {
+  size_t ioThreads = 1;
+  size_t parseThreads = 1;
+  size_t renderThreads = 1;
+  size_t encodeThreads = 1;
+  size_t queueDepth = 0; // 0 = 2 x hilos de la etapa consumidora
+
+  // Reparto por defecto para `hw` núcleos
+  static PipelineConfig defaults(size_t hw);
+};
+
+// Pipeline por etapas: lectura (prefetch de I/O) -> parseo y propiedades ->
+// rasterizado -> codificación (PNG, QOI o PPM) y escritura. Con
+// RenderSettings::stream la última etapa no escribe archivos sino que entrega
+// los frames a un FrameStream, que los reordena por índice. Con
+// RenderSettings::persist, entre el rasterizado y la codificación un hilo
+// ordena los frames y los mezcla con los anteriores (FrameBlender). Con
+// RenderSettings::tile, un hilo toma los frames de a uno y reparte sus tiles
+// (y la compresión) entre los hilos de rasterizado y codificación. Con
+// RenderSettings::outputs, cada frame se parsea una vez (cada archivo de
+// valores se lee una vez y de él salen todas las propiedades que lo usan) y
+// el rasterizado dibuja todas las salidas desde los mismos granos. Con menos
+// frames que hilos de rasterizado, cada frame se divide en franjas que se
+// dibujan en paralelo con todos ellos (Renderer::setBands).
+//
+// Cada etapa tiene su propio grupo de hilos y se conecta con la siguiente por
+// una BoundedQueue: cuando una etapa se atrasa, las colas llenas frenan a las
+// anteriores, de modo que la memoria en vuelo queda acotada mientras el disco
+// y todos los núcleos siguen ocupados.
+//
+// Cada frame en vuelo toma del pool una arena (FrameArena) con la que se
+// construyen sus granos, temporales y puntos del histograma; al terminar el
+// frame la arena se rebobina y vuelve al pool, que tiene tantas como frames
+// pueden estar en vuelo a la vez. Del mismo modo, el rasterizado dibuja sobre
+// superficies (Canvas) de un pool que se reutilizan durante toda la corrida.
+class FramePipeline {
+public:
+  // Con `manifest`, cada frame terminado se registra allí junto con su aporte
+  // al histograma; con `series`, también se suma a sus ventanas de tiempo
+  FramePipeline(const RenderSettings &settings, const PipelineConfig &config,
+                MagnitudeHistogram &histogram, RunManifest *manifest = nullptr,
+                HistogramSeries *series = nullptr);
+
+  // Procesa todos los trabajos; devuelve la cantidad de frames escritos
+  size_t run(const std::vector<FrameJob> &jobs);
+
+private:
+  struct FrameInput;
+  struct ParsedFrame;
+  struct RenderedFrame;
+  struct FrameMemory;
+  using MemoryLease = PoolLease<FrameMemory>;
+  using CanvasLease = PoolLease<Canvas>;
+
+  bool read(const FrameJob &job, FrameInput &out) const;
+  bool parse(FrameInput &in, ParsedFrame &out);
+  using Renderers = std::vector<std::unique_ptr<Renderer>>; // uno por salida
+
+  // Escalares de las salidas adicionales cuya propiedad usa el archivo de
+  // valores `extension` (ya leído en `values`)
+  void outputColumns(const GrainStore &grains, const ValueTable &values,
+                     const std::string &extension, FrameMemory &mem) const;
+  bool rasterize(ParsedFrame &in, RenderedFrame &out,
+                 Renderers &renderers) const;
+  bool encode(RenderedFrame &in, ImageWriter &writer);
+  bool renderTiled(ParsedFrame &in, TiledRenderer &tiles);
+  void discard(const FrameJob &job);
+  void fail(const FrameJob &job);
+  void complete(const FrameJob &job, const HistogramPoints &points);
+
+  RenderSettings settings_;
+  std::vector<RenderSettings> outputs_; // settings_.output(k) de cada salida
+  PipelineConfig config_;
+  MagnitudeHistogram &histogram_;
+  RunManifest *manifest_;
+  HistogramSeries *series_;
+  BoundedQueue<FrameMemory *> *pool_ = nullptr; // arenas libres (en run)
+  BoundedQueue<Canvas *> *canvases_ = nullptr;  // superficies libres (en run)
+  std::vector<BoundedQueue<Canvas *> *> outputCanvases_; // por salida (en run)
+  FrameStream *stream_ = nullptr;               // flujo de salida (en run)
+  BoundedQueue<RenderedFrame> *ordered_ = nullptr; // entrada de la mezcla
+};
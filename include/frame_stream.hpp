@@ -0,0 +1,91 @@
+#pragma once
+#include "image_writer.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <vector>
+
+// Contenedor del flujo de video
+enum class StreamFormat { Y4m, Rgb };
+
+struct StreamOptions {
+  std::string path;        // archivo de salida; "-" = stdout; vacío = sin flujo
+  StreamFormat format = StreamFormat::Y4m;
+  int fps = 25;            // sólo va en el encabezado Y4M
+
+  bool enabled() const { return !path.empty(); }
+
+  // Texto -> opción; false si no se reconoce
+  static bool parseFormat(const std::string &name, StreamFormat &format);
+  static const char *formatName(StreamFormat format);
+};
+
+// Flujo ordenado de frames: un único Y4M (4:4:4, BT.601 de rango limitado) o
+// RGB24 crudo, en lugar de un archivo por frame. Se conecta directo a ffmpeg
+// (`--stream - | ffmpeg -i - ...`) sin pasar por el disco.
+//
+// Los hilos de codificación terminan los frames en cualquier orden: cada uno
+// convierte el suyo a un buffer y lo deja en un buffer de reorden; el hilo
+// que completa el siguiente índice esperado escribe esa tanda en orden. Para
+// acotar la memoria, quien alimenta el pipeline llama admit() antes de cada
+// frame: sólo pueden estar admitidos `window` frames desde el próximo a
+// escribir, así que el buffer de reorden nunca guarda más que eso
+// y ninguna etapa queda esperando el orden (no hay deadlock con las colas).
+//
+// Cada índice admitido debe terminar en submit() o skip(); un frame omitido
+// simplemente falta en el video.
+class FrameStream {
+public:
+  FrameStream(const StreamOptions &options, int width, int height,
+              size_t window);
+  ~FrameStream();
+
+  FrameStream(const FrameStream &) = delete;
+  FrameStream &operator=(const FrameStream &) = delete;
+
+  // false si no se pudo abrir la salida (con el error en std::cerr)
+  bool valid() const { return file_ != nullptr; }
+
+  // Reserva un lugar en la ventana para el próximo frame (bloquea si no
+  // hay); se llama una vez por frame, en el orden de los índices
+  void admit();
+
+  // Convierte `image` y la encola para escribirse en su turno
+  void submit(size_t index, const ImageView &image);
+
+  // El frame `index` no llegará (error de lectura, parseo o render)
+  void skip(size_t index);
+
+  // Escribe lo pendiente y cierra; false si hubo errores de escritura
+  bool finish();
+
+  size_t written() const { return written_; }
+
+private:
+  struct Slot {
+    std::vector<unsigned char> bytes; // vacío = omitido
+  };
+
+  void convert(const ImageView &image, std::vector<unsigned char> &out) const;
+  void deposit(size_t index, Slot slot);
+
+  StreamOptions options_;
+  int width_, height_;
+  FILE *file_ = nullptr;
+  bool ownsFile_ = false;
+  bool failed_ = false;
+
+  std::counting_semaphore<> window_; // lugares libres en el buffer de reorden
+
+  std::mutex mutex_;
+  std::map<size_t, Slot> pending_; // terminados que esperan su turno
+  size_t next_ = 0;                // próximo índice a escribir
+  bool writing_ = false;           // un hilo está escribiendo una tanda
+  std::condition_variable idle_;   // writing_ volvió a false
+  std::vector<std::vector<unsigned char>> spare_; // buffers para reutilizar
+  size_t written_ = 0;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "grain_store.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Caja envolvente en coordenadas físicas
+struct GrainBox {
+  double x0, y0, x1, y1;
+
+  bool touches(const GrainBox &o) const {
+    return x1 >= o.x0 && x0 <= o.x1 && y1 >= o.y0 && y0 <= o.y1;
+  }
+  bool contains(const GrainBox &o) const {
+    return x0 <= o.x0 && o.x1 <= x1 && y0 <= o.y0 && o.y1 <= y1;
+  }
+};
+
+// Índices de los granos de cada tipo, en orden creciente (el de dibujo)
+struct GrainSelection {
+  std::vector<uint32_t> circles, polygons, walls;
+};
+
+// Índice espacial de un frame: la caja de cada grano, calculada una vez al
+// parsear, y una grilla uniforme (celdas en CSR) con cada grano en la celda
+// de su centro. Una consulta sólo visita las celdas de la región (agrandada
+// en el mayor medio lado de grano), así que el costo depende de lo que se ve
+// y no del total de granos. Las paredes son pocas y largas: no van a la
+// grilla, se prueban una por una.
+class GrainIndex {
+public:
+  explicit GrainIndex(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource());
+
+  void build(const GrainStore &grains);
+  void clear();
+
+  // Caja de todos los granos (sin paredes)
+  const GrainBox &bounds() const { return bounds_; }
+  const GrainBox &circleBox(size_t i) const { return circleBoxes_[i]; }
+  const GrainBox &polygonBox(size_t i) const { return polygonBoxes_[i]; }
+  const GrainBox &wallBox(size_t i) const { return wallBoxes_[i]; }
+
+  // Los granos y paredes cuya caja toca `region`
+  void query(const GrainBox &region, GrainSelection &out) const;
+
+  // Centro y escalar de cada grano (no paredes) que puede caer en `region`,
+  // para el histograma: el centro del círculo o el de la caja del polígono;
+  // primero los círculos y después los polígonos, en su orden. Con
+  // `footprints`, también la huella: un cuadrado del área del círculo, o la
+  // caja del polígono achicada a su área. Si `region` no cubre todos los
+  // granos la consulta se hace en `scratch`, que conviene reutilizar entre
+  // frames (conserva su capacidad).
+  void centres(const GrainStore &grains, const GrainBox &region,
+               bool footprints, HistogramPoints &out,
+               GrainSelection &scratch) const;
+
+private:
+  // Celdas que cubre una caja, recortadas a la grilla
+  void cellRange(const GrainBox &b, int &cx0, int &cy0, int &cx1,
+                 int &cy1) const;
+
+  std::pmr::vector<GrainBox> circleBoxes_, polygonBoxes_, wallBoxes_;
+  GrainBox bounds_{0, 0, -1, -1};
+
+  // Grilla: la celda (cx, cy) tiene items[start[c] .. start[c+1]) con
+  // c = cy * cols_ + cx; los polígonos llevan kPolygon en el bit alto
+  static constexpr uint32_t kPolygon = 0x80000000u;
+  int cols_ = 0, rows_ = 0;
+  double cell_ = 1.0;
+  double reach_ = 0.0; // mayor medio lado de la caja de un grano
+  std::pmr::vector<uint32_t> start_, items_;
+};
+
+// Copia a `to` (vaciándolo antes) los granos seleccionados de `from`, en el
+// mismo orden
+void copySelection(const GrainStore &from, const GrainSelection &sel,
+                   GrainStore &to);
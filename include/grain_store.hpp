@@ -0,0 +1,169 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Conversión de coordenadas (x,y) físicas a (sx,sy) de pantalla: una
+// transformación afín con escala uniforme y el eje y invertido
+struct ScreenTransform {
+  double scale = 1.0;
+  double xmin = 0.0, ymin = 0.0; // esquina física inferior izquierda
+  double left = 0.0;             // sx de xmin
+  double bottom = 0.0;           // sy de ymin
+
+  double sx(double x) const { return left + (x - xmin) * scale; }
+  double sy(double y) const { return bottom - (y - ymin) * scale; }
+
+  // Inversa: (sx,sy) de pantalla -> (x,y) físicas
+  double wx(double sx) const { return xmin + (sx - left) / scale; }
+  double wy(double sy) const { return ymin + (bottom - sy) / scale; }
+
+  // Encaja [xmin,xmax] x [ymin,ymax] en la imagen manteniendo la relación de
+  // aspecto y centrando el espacio sobrante
+  static ScreenTransform fit(int width, int height, double margin,
+                             double xmin, double xmax, double ymin,
+                             double ymax);
+};
+
+// Las columnas son contenedores std::pmr: por defecto usan el heap, y el
+// pipeline las construye sobre la arena del frame (ver frame_arena.hpp)
+
+// ---------------- Puntos del histograma ----------------
+// Centro y escalar de cada grano, tal como los consume el histograma (ver
+// GrainIndex::centres), y medio ancho y medio alto de su huella (una caja de
+// la misma área que el grano) si el histograma la usa
+struct HistogramPoints {
+  std::pmr::vector<double> x, y, value;
+  std::pmr::vector<double> halfW, halfH; // vacías sin huellas
+
+  explicit HistogramPoints(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : x(mem), y(mem), value(mem), halfW(mem), halfH(mem) {}
+
+  size_t size() const { return x.size(); }
+  void clear();
+  void reserve(size_t n, bool footprints);
+
+  void add(double cx, double cy, double s) {
+    x.push_back(cx);
+    y.push_back(cy);
+    value.push_back(s);
+  }
+  void add(double cx, double cy, double s, double hw, double hh) {
+    add(cx, cy, s);
+    halfW.push_back(hw);
+    halfH.push_back(hh);
+  }
+};
+
+// ---------------- Círculos ----------------
+struct CircleColumns {
+  std::pmr::vector<int> gid;
+  std::pmr::vector<int> type;
+  std::pmr::vector<double> x, y, r;
+  std::pmr::vector<double> scalar;
+
+  explicit CircleColumns(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : gid(mem), type(mem), x(mem), y(mem), r(mem), scalar(mem) {}
+
+  size_t size() const { return gid.size(); }
+  void clear();
+
+  void add(int g, int t, double cx, double cy, double radius, double s) {
+    gid.push_back(g);
+    type.push_back(t);
+    x.push_back(cx);
+    y.push_back(cy);
+    r.push_back(radius);
+    scalar.push_back(s);
+  }
+};
+
+// ---------------- Polígonos (CSR) ----------------
+// Los vértices del polígono i son vx/vy[offset[i] .. offset[i+1])
+struct PolygonColumns {
+  std::pmr::vector<int> gid;
+  std::pmr::vector<int> type;
+  std::pmr::vector<uint32_t> offset;
+  std::pmr::vector<double> vx, vy;
+  std::pmr::vector<double> scalar;
+
+  explicit PolygonColumns(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : gid(mem), type(mem), offset(1, 0, mem), vx(mem), vy(mem),
+        scalar(mem) {}
+
+  size_t size() const { return gid.size(); }
+  size_t vertices() const { return vx.size(); }
+  void clear();
+
+  // Los vértices se agregan primero y `close` cierra el polígono con todos
+  // los agregados desde el anterior (así el parser no necesita un buffer)
+  void addVertex(double x, double y) {
+    vx.push_back(x);
+    vy.push_back(y);
+  }
+  void close(int g, int t, double s) {
+    gid.push_back(g);
+    type.push_back(t);
+    scalar.push_back(s);
+    offset.push_back(static_cast<uint32_t>(vx.size()));
+  }
+};
+
+// Un frame completo en columnas: sin una asignación por grano ni despacho
+// virtual. Las paredes del contenedor (gid < 0) se guardan aparte como
+// polilíneas abiertas, con escalar -1.
+struct GrainStore {
+  CircleColumns circles;
+  PolygonColumns polygons;
+  PolygonColumns walls;
+
+  explicit GrainStore(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : circles(mem), polygons(mem), walls(mem) {}
+
+  std::pmr::memory_resource *resource() const {
+    return circles.gid.get_allocator().resource();
+  }
+
+  size_t size() const {
+    return circles.size() + polygons.size() + walls.size();
+  }
+  bool empty() const { return size() == 0; }
+
+  void reserve(size_t grains, size_t vertices);
+
+  // Vacía las columnas conservando su capacidad
+  void clear();
+
+  // Rango de los escalares (incluye el -1 de las paredes); false si no hay
+  // granos
+  bool scalarRange(double &vmin, double &vmax) const;
+};
+
+// Escalares de otra propiedad del mismo frame, uno por círculo y uno por
+// polígono en el orden del GrainStore (las paredes no tienen). Varias
+// salidas se dibujan de un único parseo intercambiándolos con los del
+// GrainStore (swapScalars); ambos deben usar el mismo memory_resource.
+struct ScalarColumns {
+  std::pmr::vector<double> circles, polygons;
+
+  explicit ScalarColumns(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : circles(mem), polygons(mem) {}
+};
+
+inline void swapScalars(GrainStore &grains, ScalarColumns &other) {
+  grains.circles.scalar.swap(other.circles);
+  grains.polygons.scalar.swap(other.polygons);
+}
+
+// Recorre los polígonos con `fn(i, begin, end)` sobre el rango de vértices
+template <typename Fn> void forEachPolygon(const PolygonColumns &p, Fn &&fn) {
+  const size_t n = p.size();
+  for (size_t i = 0; i < n; ++i)
+    fn(i, p.offset[i], p.offset[i + 1]);
+}
@@ -2,23 +2,71 @@
 #define PRESSURE_HISTOGRAM_HPP
 
 #include <vector>
+#include <memory>
 #include <mutex>
 #include <atomic>
 #include <fstream>
 #include <string>
+#include <cstdint>
+#include <span>
+#include <thread>
 
+// Histograma 2D del promedio de una magnitud por celda
+//
+// Por defecto cada punto suma su valor a la celda de su centro; en modo área
+// (setAreaWeighted) el valor de un grano se reparte entre las celdas que toca
+// su huella, pesado por el área de la intersección, y el promedio de cada
+// celda queda pesado por área.
+//
+// Sumas, pesos y cuentas en buffers contiguos fila por fila (celda
+// i * bins_x + j).
+// Cada hilo que suma puntos lo hace en su propio fragmento (shard), sin locks
+// ni memoria compartida con los demás; los fragmentos se juntan con una
+// reducción en árbol (en paralelo si la grilla es grande) sólo en reduce(),
+// que no debe correr a la par de addPoint/addPoints.
 class MagnitudeHistogram {
 public:
+    // Puntos de un frame en columnas: centro, valor y medio ancho y medio
+    // alto de la huella (una caja centrada; sólo hacen falta en modo área)
+    struct Points {
+        std::span<const double> x, y, value;
+        std::span<const double> half_w, half_h;
+    };
+
+    // Celdas de 1x1 unidades (bins = ancho y alto truncados)
     MagnitudeHistogram(double xmin, double xmax, double ymin, double ymax);
-    // MagnitudeHistogram(int bins_x, int bins_y, double xmin, double xmax, double ymin, double ymax);
-    
-    // Thread-safe: agregar un punto de datos
+    // `bins_x` x `bins_y` celdas que cubren exactamente el rango
+    MagnitudeHistogram(int bins_x, int bins_y, double xmin, double xmax, double ymin, double ymax);
+
+    // Modo área (llamar antes de sumar puntos)
+    void setAreaWeighted(bool on) { area_weighted_ = on; }
+    bool areaWeighted() const { return area_weighted_; }
+
+    // Thread-safe: agregar un punto de datos (en el centro de su celda aun
+    // en modo área: no tiene huella)
     void addPoint(double x, double y, double magnitude);
     
     // Thread-safe: agregar múltiples puntos (para eficiencia)
-    void addPoints(const std::vector<std::tuple<double, double, double>>& points);
+    void addPoints(const Points& points);
+
+    // Suma los fragmentos de todos los hilos a las sumas y los vacía. No debe
+    // correr a la par de addPoint/addPoints (el manifest los frena mientras).
+    void reduce();
+
+    // Media y momento de segundo orden (Welford pesado) por celda de los
+    // puntos de un frame, para las series por ventanas (ver HistogramSeries)
+    struct Moments {
+        std::vector<uint32_t> cells; // celdas tocadas
+        std::vector<double> weights, means, m2;
+        std::vector<int> counts;
+        std::vector<int32_t> scratch;
+    };
+    // Agrupa `points` por celda en `out` (vaciándolo antes); no toca el
+    // histograma
+    void moments(const Points& points, Moments& out) const;
     
-    // Calcular promedios (llamar después de que todos los hilos terminen)
+    // Calcular promedios (llamar después de que todos los hilos terminen;
+    // reduce antes)
     void computeAverages();
     
     // Guardar en formato legible por matplotlib
@@ -30,6 +78,8 @@ public:
     // Getters para información de la grilla
     int getBinsX() const { return bins_x_; }
     int getBinsY() const { return bins_y_; }
+    double getCellWidth() const { return cell_width_; }
+    double getCellHeight() const { return cell_height_; }
     double getXMin() const { return xmin_; }
     double getXMax() const { return xmax_; }
     double getYMin() const { return ymin_; }
@@ -38,16 +88,59 @@ public:
     // Obtener el valor promedio en una celda específica
     double getAverage(int i, int j) const;
 
+    // Checkpoint binario de sumas, pesos y cuentas (no de promedios). `generation`
+    // identifica el manifest al que corresponde; se escribe a un temporal y
+    // se renombra para que un corte nunca deje un checkpoint a medias.
+    // Escribe las sumas ya reducidas: lo que sigue en los fragmentos no entra
+    // (llamar antes a reduce()), así que puede correr a la par de addPoints.
+    void saveState(const std::string& filename, uint64_t generation) const;
+
+    // Restaura sumas, pesos y cuentas; false si el archivo no existe, está
+    // dañado, es de otra generación, de otra grilla o de otro modo
+    bool loadState(const std::string& filename, uint64_t generation);
+
+    // Vaciar sumas y cuentas
+    void clear();
+
 private:
+    struct Shard {
+        std::thread::id owner;
+        bool dirty = false; // tiene algo desde la última reducción
+        std::vector<double> sums;
+        std::vector<double> weights;
+        std::vector<int> counts;
+        std::vector<int32_t> scratch;
+    };
+
+    // Celda de (x, y); -1 si cae fuera del rango
+    int cellOf(double x, double y) const;
+    // Llama a hit(celda, peso, valor) por cada celda que toca cada punto, en
+    // el orden de los puntos: peso 1 en la celda del centro, o el área de la
+    // intersección con la huella en modo área
+    template <typename Hit>
+    void scan(const Points& points, std::vector<int32_t>& scratch, Hit&& hit) const;
+    template <typename Hit>
+    void scanAreas(const Points& points, Hit& hit) const;
+    // Suma `points` a las columnas por celda
+    void accumulate(const Points& points, double* sums, double* weights, int* counts,
+                    std::vector<int32_t>& scratch) const;
+    // Fragmento del hilo que llama (se crea la primera vez)
+    Shard& shard();
+
     int bins_x_, bins_y_;
     double xmin_, xmax_, ymin_, ymax_;
     double cell_width_, cell_height_;
+    bool area_weighted_ = false;
     
-    std::vector<std::vector<double>> magnitude_sums_;
-    std::vector<std::vector<int>> counts_;
-    std::vector<std::vector<double>> averages_;
+    std::vector<double> magnitude_sums_; // bins_y_ filas de bins_x_
+    std::vector<double> weights_;        // cuentas, o áreas en modo área
+    std::vector<int> counts_;
+    std::vector<double> averages_;
+
+    uint64_t id_; // único por instancia: clave de la caché de fragmento del hilo
+    std::vector<std::unique_ptr<Shard>> shards_;
     
-    mutable std::mutex mutex_;
+    std::mutex mutex_; // protege shards_, no las sumas
     std::atomic<bool> averages_computed_{false};
 };
 
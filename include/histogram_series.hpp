@@ -0,0 +1,75 @@
+#pragma once
+#include "histogram_magnitude_2d.hpp"
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Histogramas por ventanas de tiempo
+//
+// Los frames se agrupan por su posición en la corrida: la ventana k cubre los
+// frames [k * stride, k * stride + window), así que con stride == window las
+// ventanas son consecutivas y con stride < window se solapan (ventana
+// deslizante). En cada celda, con la grilla y el modo (centro o área) del
+// histograma global, se acumulan la media y la varianza de los valores de
+// todos los granos de la ventana: Welford pesado dentro de cada frame y la
+// combinación de Chan entre frames.
+//
+// Los frames llegan en cualquier orden. Una ventana se escribe a
+// `<dir>/window_NNNNN.csv` apenas terminaron todos sus frames y se libera, y
+// se agrega una línea a `<dir>/windows.csv`; en memoria sólo están las
+// ventanas abiertas.
+class HistogramSeries {
+public:
+  HistogramSeries(const MagnitudeHistogram &grid, size_t frames, size_t window,
+                  size_t stride, const std::string &dir);
+
+  HistogramSeries(const HistogramSeries &) = delete;
+  HistogramSeries &operator=(const HistogramSeries &) = delete;
+
+  // Thread-safe: suma los puntos del frame `frame` a sus ventanas
+  void add(size_t frame, const MagnitudeHistogram::Points &points);
+  // Thread-safe: el frame `frame` no aporta (no se pudo leer o dibujar); no
+  // hace nada si el frame ya se sumó
+  void skip(size_t frame);
+  // Escribe las ventanas que quedaron abiertas (frames que no terminaron)
+  void finish();
+
+  size_t windows() const { return windows_; }
+  const std::string &dir() const { return dir_; }
+
+private:
+  struct Window {
+    size_t pending;    // frames que faltan
+    size_t frames = 0; // frames que aportaron
+    std::vector<bool> seen; // por frame de la ventana: sumado u omitido
+    std::vector<double> weights, means, m2;
+    std::vector<int> counts;
+  };
+
+  // Ventanas [first, last] que contienen `frame`; false si ninguna
+  bool range(size_t frame, size_t &first, size_t &last) const;
+  size_t begin(size_t k) const { return k * stride_; }
+  size_t end(size_t k) const;
+  using Closed = std::vector<std::pair<size_t, std::unique_ptr<Window>>>;
+  // Marca `frame` en sus ventanas todavía abiertas que no lo tenían y llama a
+  // `merge(window)` en cada una; devuelve en `closed` las que se completaron
+  template <typename Merge>
+  void markLocked(size_t frame, size_t first, size_t last, Closed &closed,
+                  Merge &&merge);
+  void write(size_t k, const Window &w);
+
+  const MagnitudeHistogram &grid_;
+  size_t frames_, window_, stride_, windows_;
+  std::string dir_;
+
+  std::map<size_t, std::unique_ptr<Window>> open_;
+  std::vector<bool> closed_; // ventanas ya escritas
+  std::mutex mutex_;
+
+  std::ofstream index_; // windows.csv
+  std::mutex indexMutex_;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+// Formato de las imágenes de salida
+enum class ImageFormat { Png, Qoi, Ppm };
+
+// Filtro de filas del PNG: Adaptive elige, fila por fila, el que deja la
+// menor suma de diferencias (la heurística de libpng)
+enum class PngFilter { None, Sub, Up, Paeth, Adaptive };
+
+struct EncodeOptions {
+  ImageFormat format = ImageFormat::Png;
+  int pngLevel = 6; // nivel de zlib: 0 = sin compresión, 1 = rápido, 9 = máximo
+  PngFilter pngFilter = PngFilter::Adaptive;
+
+  // Extensión de los archivos (".png", ".qoi", ".ppm")
+  const char *extension() const;
+
+  // Texto -> opción; false si no se reconoce
+  static bool parseFormat(const std::string &name, ImageFormat &format);
+  static bool parseFilter(const std::string &name, PngFilter &filter);
+  static const char *formatName(ImageFormat format);
+  static const char *filterName(PngFilter filter);
+};
+
+// Imagen ARGB32 (el formato de Cairo) a codificar. Los frames son opacos: se
+// guarda sólo RGB.
+struct ImageView {
+  const uint32_t *data = nullptr;
+  int width = 0, height = 0;
+  int stride = 0; // en píxeles
+};
+
+// Codificador PNG (zlib con nivel y filtro elegibles), QOI o PPM binario. Cada
+// hilo de codificación tiene el suyo: el stream de zlib y los buffers se
+// reutilizan de una imagen a la siguiente.
+class ImageWriter {
+public:
+  explicit ImageWriter(const EncodeOptions &options);
+  ~ImageWriter();
+
+  ImageWriter(const ImageWriter &) = delete;
+  ImageWriter &operator=(const ImageWriter &) = delete;
+
+  // Codifica y escribe `image`; false (con el error en std::cerr) si falla
+  bool write(const ImageView &image, const std::string &filename);
+
+  // Codifica en memoria; los bytes quedan válidos hasta la próxima llamada
+  const std::vector<unsigned char> &encode(const ImageView &image);
+
+private:
+  void encodePng(const ImageView &image);
+  void encodeQoi(const ImageView &image);
+  void encodePpm(const ImageView &image);
+
+  EncodeOptions options_;
+  std::unique_ptr<z_stream_s> zs_;
+  std::vector<unsigned char> out_;
+  std::vector<unsigned char> row_, prev_; // fila RGB actual y anterior
+  std::vector<unsigned char> filtered_[5]; // la fila con cada filtro
+};
+
+// ---------------- PNG por franjas ----------------
+// Para imágenes que no entran en memoria. Cada franja de filas se filtra y
+// comprime por separado (deflate crudo, empezando con el diccionario vacío),
+// así que varias franjas pueden comprimirse en paralelo; PngStripFile las
+// escribe en orden como chunks IDAT de un único PNG y combina sus adler32.
+struct PngStrip {
+  std::vector<unsigned char> bytes; // deflate crudo de la franja
+  uint32_t adler = 1;               // adler32 de los datos sin comprimir
+  size_t rawBytes = 0;              // filas filtradas, con el byte de tipo
+
+  // Filtra y comprime `rows`. `prev` es la última fila de la franja anterior
+  // (nullptr en la primera) y `last` cierra el stream deflate.
+  void compress(const EncodeOptions &options, const ImageView &rows,
+                const uint32_t *prev, bool last);
+};
+
+class PngStripFile {
+public:
+  // Escribe la firma y el encabezado; ver valid()
+  PngStripFile(const EncodeOptions &options, const std::string &filename,
+               int width, int height);
+  ~PngStripFile();
+
+  PngStripFile(const PngStripFile &) = delete;
+  PngStripFile &operator=(const PngStripFile &) = delete;
+
+  bool valid() const { return file_ != nullptr && !failed_; }
+
+  // Agrega la siguiente franja (en orden de arriba hacia abajo)
+  bool append(const PngStrip &strip);
+
+  // Cierra el stream zlib y el PNG; false si hubo errores de escritura
+  bool finish();
+
+private:
+  bool chunk(const char type[4], const unsigned char *data, size_t len);
+
+  std::string filename_;
+  FILE *file_ = nullptr;
+  bool failed_ = false;
+  uint32_t adler_ = 1;
+};
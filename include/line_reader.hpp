@@ -0,0 +1,91 @@
+#pragma once
+#include "mapped_file.hpp"
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Lector de líneas para archivos de texto, comprimidos o no
+//
+// Los archivos planos se recorren directamente sobre el mmap. Los .gz y .zst
+// se descomprimen por bloques en un buffer reutilizable: nunca se materializa
+// el archivo entero, y las líneas que cruzan el borde de un bloque se
+// reacomodan al principio del buffer antes de descomprimir el siguiente.
+class LineReader {
+public:
+  virtual ~LineReader() = default;
+
+  // El lector mismo también se construye sobre el memory_resource
+  struct Deleter {
+    std::pmr::memory_resource *mem = nullptr;
+    size_t size = 0;
+    size_t align = 0;
+    void operator()(LineReader *r) const {
+      r->~LineReader();
+      mem->deallocate(r, size, align);
+    }
+  };
+  using Ptr = std::unique_ptr<LineReader, Deleter>;
+
+  // Abre `filename` eligiendo el decodificador por la extensión
+  // (.gz -> zlib, .zst -> zstd, otro -> texto plano). nullptr si falla.
+  // El buffer de descompresión se pide a `mem`.
+  static Ptr
+  open(const std::string &filename,
+       std::pmr::memory_resource *mem = std::pmr::get_default_resource());
+
+  // Igual, sobre un archivo ya proyectado (p.ej. precargado por otra etapa);
+  // `filename` sólo se usa para elegir el decodificador
+  static Ptr
+  open(MappedFile file, const std::string &filename,
+       std::pmr::memory_resource *mem = std::pmr::get_default_resource());
+
+  // Próxima línea (sin '\n'); false al llegar al final del archivo.
+  // La vista es válida hasta la siguiente llamada.
+  bool next(std::string_view &line) {
+    for (;;) {
+      auto nl = pending_.find('\n');
+      if (nl != std::string_view::npos) {
+        line = pending_.substr(0, nl);
+        pending_.remove_prefix(nl + 1);
+        return true;
+      }
+      if (eof_ || !refill()) {
+        eof_ = true;
+        if (pending_.empty())
+          return false;
+        line = pending_;
+        pending_ = {};
+        return true;
+      }
+    }
+  }
+
+  // Pide al kernel que adelante la lectura del archivo (plano o comprimido)
+  void willNeed() const { source_.willNeed(); }
+
+protected:
+  explicit LineReader(MappedFile source) : source_(std::move(source)) {}
+
+  // Agrega más texto a `pending_`; false si no queda nada por leer
+  virtual bool refill() = 0;
+
+  MappedFile source_;
+  std::string_view pending_;
+  bool eof_ = false;
+};
+
+namespace Compression {
+
+// Sufijos de compresión reconocidos, en orden de preferencia
+inline constexpr const char *suffixes[] = {"", ".gz", ".zst"};
+
+// Devuelve el sufijo de compresión de `filename` ("" si no está comprimido)
+std::string_view suffix(std::string_view filename);
+
+// Primer archivo existente entre base+ext, base+ext.gz y base+ext.zst;
+// cadena vacía si no hay ninguno
+std::string findInput(const std::string &base, const std::string &ext);
+
+} // namespace Compression
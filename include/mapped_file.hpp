@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Archivo de solo lectura proyectado en memoria (mmap). El contenido se expone
+// como un string_view sin copias; el mapeo se libera en el destructor.
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &filename);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  // true si el archivo pudo abrirse (un archivo vacío es válido)
+  bool valid() const { return valid_; }
+  std::string_view view() const {
+    return {static_cast<const char *>(data_), size_};
+  }
+  std::size_t size() const { return size_; }
+
+  // Pide al kernel que empiece a leer todo el archivo en segundo plano
+  void willNeed() const;
+
+  // Lee efectivamente todas las páginas (bloquea hasta que estén en memoria)
+  void prefault() const;
+
+private:
+  void release();
+
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+  bool valid_ = false;
+};
@@ -1,27 +1,64 @@
 #pragma once
-#include "grain.hpp"
-#include <memory>
+#include "frame_binary.hpp"
+#include "grain_store.hpp"
+#include "line_reader.hpp"
+#include <span>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+#include "value_table.hpp"
+
 // Lee frm_XXX.xy y frm_XXX.sxy, devuelve lista de granos con valor escalar
 // calculado
 namespace Parser {
 
-// Lee archivo .sxy -> devuelve un mapa gid -> vector<double>
-std::unordered_map<int, std::vector<double>>
-readSXY(const std::string &filename);
+// Lee archivo .sxy -> devuelve la tabla gid -> valores crudos
+ValueTable readSXY(const std::string &filename);
+
+// Igual, sobre un lector ya abierto y agregando a `values`
+void readSXY(LineReader &file, ValueTable &values);
 
 // Construye los granos leyendo frm_XXX.xy y asociando el valor de la propiedad
-std::vector<std::unique_ptr<Grain>>
-readXY(const std::string &filename,
-       const std::unordered_map<int, std::vector<double>> &scalarData,
-       const std::string &property);
+GrainStore readXY(const std::string &filename, const ValueTable &scalarData,
+                  const std::string &property);
+// Igual, agregando a `grains` (que conserva su memory_resource)
+bool readXY(const std::string &filename, const ValueTable &scalarData,
+            const std::string &property, GrainStore &grains);
+void readXY(LineReader &file, const ValueTable &scalarData,
+            const std::string &property, GrainStore &grains);
+
+// Lee frm_XXX.xy y su archivo de valores en una sola pasada (merge-join):
+// ambos listan los granos en orden creciente de gid, así que se avanzan a
+// la par sin tabla intermedia. Si detecta ids fuera de orden vuelve a
+// readSXY + readXY.
+GrainStore readFrame(const std::string &xyFile, const std::string &valuesFile,
+                     const std::string &property);
+
+// Igual, sobre lectores ya abiertos (los nombres se usan para el respaldo)
+GrainStore readFrame(LineReader &xy, LineReader &values,
+                     const std::string &xyFile, const std::string &valuesFile,
+                     const std::string &property);
+bool readFrame(LineReader &xy, LineReader &values, const std::string &xyFile,
+               const std::string &valuesFile, const std::string &property,
+               GrainStore &grains);
 
 // Calcula propiedad a partir de valores crudos de .sxy
 double computeProperty(const std::string &property,
-                       const std::vector<double> &values);
+                       std::span<const double> values);
+
+// Calcula varias propiedades de cada grano de `grains` en una sola pasada:
+// la fila de cada gid se busca una vez en `values` y `out[k]` recibe
+// `properties[k]` (0 si el grano no tiene fila)
+void computeColumns(const GrainStore &grains, const ValueTable &values,
+                    std::span<const std::string> properties,
+                    std::span<ScalarColumns *const> out);
+
+// Extensión del archivo de valores que usa la propiedad (".sxy" o ".ve")
+std::string valuesExtension(const std::string &property);
+
+// Lectores crudos (sin calcular propiedades), usados por el conversor a .gfb
+bool readXYColumns(const std::string &filename, FrameColumns &cols);
+bool readValueColumns(const std::string &filename, ValueColumns &cols);
 
 } // namespace Parser
 
@@ -1,16 +1,93 @@
 #pragma once
 #include "colormap.hpp"
-#include "grain.hpp"
-#include <memory>
+#include "grain_index.hpp"
+#include "grain_store.hpp"
+#include <cairo/cairo.h>
+#include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
+// Quién rasteriza los granos: Cairo (referencia) o el rasterizador por
+// software de soft_raster.hpp. Fondo, paredes y barra de colores siempre van
+// por Cairo, sobre la misma superficie.
+enum class RenderBackend { Cairo, Soft };
+
+class ThreadPool;
+
+// Superficie ARGB32 y su contexto de Cairo, creados una vez y reutilizados
+// frame tras frame
+class Canvas {
+public:
+  Canvas(int width, int height);
+  ~Canvas();
+
+  Canvas(const Canvas &) = delete;
+  Canvas &operator=(const Canvas &) = delete;
+
+  cairo_surface_t *surface() const { return surface_; }
+  cairo_t *context() const { return cr_; }
+
+private:
+  cairo_surface_t *surface_;
+  cairo_t *cr_;
+};
+
 class Renderer {
 public:
-  Renderer(int width, int height, double margin, double valmin, double valmax);
+  // Con `batched` (backend Cairo) los granos se agrupan por color y cada
+  // grupo se rellena con un solo camino y un solo cairo_fill. Con `lod` > 0
+  // los granos de radio en pantalla menor que `lod` píxeles (medio lado de
+  // la caja, para los polígonos) no se rasterizan: se acumulan como una
+  // huella de 2x2 píxeles pesada por su área (SoftRaster::splat).
+  Renderer(int width, int height, double margin, double valmin, double valmax,
+           RenderBackend backend = RenderBackend::Cairo, bool batched = false,
+           double lod = 0.0);
+  ~Renderer();
+
+  // Conserva la capa de paredes y la barra de colores entre frames: un
+  // Renderer por hilo
+  Renderer(const Renderer &) = delete;
+  Renderer &operator=(const Renderer &) = delete;
+
+  // Dibuja el frame sobre `canvas` (del mismo tamaño que el Renderer),
+  // reemplazando lo que tuviera. Con `index` (el de `grains`) sólo se
+  // recorren los granos que caen en la imagen, p.ej. con --xylimits sobre
+  // una parte del silo.
+  void render(Canvas &canvas, const GrainStore &grains,
+              const GrainIndex *index, double vmin, double vmax, double xmin,
+              double xmax, double ymin, double ymax,
+              const Colormap &cmap, const std::string &cbar_title = "",
+              const std::string &cbar_unit = "");
+
+  // Con `bands` > 1 cada frame de render() se divide en ese número de franjas
+  // horizontales que se dibujan en paralelo en `pool` (compartido con otros
+  // Renderer, debe vivir más que éste), cada una con sólo los granos que la
+  // tocan y sobre sus propias filas del canvas. Para jobs de pocos frames con
+  // muchos granos; la imagen es la misma que sin franjas.
+  void setBands(ThreadPool *pool, int bands);
+
+  // Dibuja sobre `canvas` la porción de la imagen completa (width x height
+  // del Renderer) cuya esquina superior izquierda es (x0, y0), con el mismo
+  // resultado que esa porción de render(). Sin capa de paredes ni barra de
+  // colores cacheadas del tamaño de la imagen: es para imágenes por tiles que
+  // no entran en memoria, y `grains` pueden ser sólo los que tocan el tile.
+  // La escala de colores es la del Renderer (valmin, valmax).
+  void renderTile(Canvas &canvas, int x0, int y0, const GrainStore &grains,
+                  double xmin, double xmax, double ymin, double ymax,
+                  const Colormap &cmap);
+
+  // Dibuja el frame en una superficie nueva (el llamador la destruye)
+  cairo_surface_t *render(const GrainStore &grains, double vmin, double vmax,
+                          double xmin, double xmax, double ymin, double ymax,
+                          const Colormap &cmap,
+                          const std::string &cbar_title = "",
+                          const std::string &cbar_unit = "");
+
+  // Codifica y guarda una superficie ya dibujada
+  static bool writePNG(cairo_surface_t *surface, const std::string &filename);
 
-  void renderToPNG(const std::string &filename,
-                   const std::vector<std::unique_ptr<Grain>> &grains,
+  void renderToPNG(const std::string &filename, const GrainStore &grains,
                    double vmin, double vmax, double xmin, double xmax,
                    double ymin, double ymax, const Colormap &cmap,
                    const std::string &cbar_title = "",
@@ -22,6 +99,118 @@ public:
                     const std::string &unit);
 
 private:
+  // ---- Capa de paredes estáticas ----
+  // Las paredes estáticas se dibujan una vez en `layer_`, transparente, que
+  // se compone sobre los granos de cada frame; las paredes móviles se dibujan
+  // encima con Cairo. Las paredes quedan siempre sobre los granos, como en
+  // renderTile. Una pared es estática si su geometría no cambió respecto del
+  // frame anterior que vio este Renderer.
+  struct WallTrack {
+    int gid;
+    uint64_t hash;   // gid y vértices
+    unsigned frames; // frames consecutivos con la misma geometría
+  };
+
+  void classifyWalls(const PolygonColumns &walls);
+  void updateLayer(const GrainStore &grains, const ScreenTransform &toScreen,
+                   const Colormap &cmap);
+  // Compone la capa sobre `surface`, que empieza en la fila `y0` de la imagen
+  void drawLayer(cairo_surface_t *surface, int y0) const;
+
+  // Tramo [x0, x1) de la fila `y` de la capa con píxeles no transparentes
+  struct LayerRun {
+    int y, x0, x1;
+  };
+
+  // ---- Barra de colores ----
+  // Se dibuja una vez por (colormap, valmin, valmax, tamaño) sobre una
+  // superficie transparente y se compone encima de cada frame, recortada a
+  // la zona que ocupa
+  void updateOverlay(const Colormap &cmap);
+  // Compone la barra sobre `surface`, que empieza en la fila `y0` de la imagen
+  void drawOverlay(cairo_surface_t *surface, int y0) const;
+  void colorbarRect(double &x, double &y, double &w, double &h) const;
+
+  // Índices de los granos agrupados por nivel del colormap (counting sort)
+  struct LevelBuckets {
+    std::vector<uint16_t> level;
+    std::vector<uint32_t> start; // el nivel l ocupa order[start[l]..start[l+1])
+    std::vector<uint32_t> order;
+
+    void build(const Colormap &cmap, std::span<const double> scalars,
+               double vmin, double vmax);
+    std::span<const uint32_t> bucket(size_t l) const {
+      return {order.data() + start[l], start[l + 1] - start[l]};
+    }
+  };
+
+  // ---- Temporales del dibujo de granos ----
+  // Uno para el frame completo y uno por franja, que se dibujan en paralelo
+  struct Scratch {
+    std::vector<char> smallCircles, smallPolygons;
+    LevelBuckets circleBuckets, polygonBuckets;
+    std::vector<double> sx, sy; // vértices en pantalla (backend Soft y LOD)
+    std::vector<uint32_t> colors; // colores ARGB32 por grano (Soft y LOD)
+    GrainSelection selection;
+    GrainStore grains; // los granos de la franja
+  };
+
+  // Granos, paredes móviles y barra de colores sobre `cr`, en coordenadas de
+  // la imagen completa; `surface` es la de `cr` y empieza en la fila `y0`
+  void drawFrame(cairo_t *cr, cairo_surface_t *surface, int y0,
+                 const GrainStore &grains, const ScreenTransform &toScreen,
+                 const Colormap &cmap, Scratch &scratch);
+  // Sólo los granos; (x0, y0): posición de `surface` en la imagen completa
+  void drawGrains(cairo_t *cr, cairo_surface_t *surface, int x0, int y0,
+                  const GrainStore &grains, const ScreenTransform &toScreen,
+                  const Colormap &cmap, Scratch &scratch);
+  // Frame completo en franjas sobre pool_ (capa y barra ya actualizadas)
+  void renderBands(cairo_surface_t *surface, const GrainStore &grains,
+                   const GrainIndex *index, const ScreenTransform &toScreen,
+                   const Colormap &cmap);
+
+  // Los granos de `grains` que se ven con `toScreen`: `grains` mismo si se
+  // ven todos, si no una copia en visible_ (con todas las paredes)
+  const GrainStore &visibleGrains(const GrainStore &grains,
+                                  const GrainIndex &index,
+                                  const ScreenTransform &toScreen);
+
+  // ---- Nivel de detalle (backend Cairo) ----
+  // Acumula los granos chicos directamente en la superficie y los marca en
+  // smallCircles/smallPolygons de `scratch` para que Cairo dibuje sólo los
+  // demás (vacíos si lod_ es 0)
+  void splatSmall(cairo_surface_t *surface, int x0, int y0,
+                  const GrainStore &grains, const ScreenTransform &toScreen,
+                  const Colormap &cmap, Scratch &scratch);
+
+  void fillBatched(cairo_t *cr, const GrainStore &grains,
+                   const ScreenTransform &toScreen, const Colormap &cmap,
+                   Scratch &scratch);
+  // (x0, y0): posición de la superficie dentro de la imagen completa
+  void rasterizeSoft(cairo_surface_t *surface, int x0, int y0,
+                     const GrainStore &grains, const ScreenTransform &toScreen,
+                     const Colormap &cmap, Scratch &scratch);
+
+  std::vector<WallTrack> walls_;
+  std::vector<char> static_; // static_[i]: la pared i está en la capa
+  cairo_surface_t *layer_ = nullptr;
+  uint64_t layerKey_ = 0;
+  std::vector<LayerRun> layerRuns_; // ordenados por fila
+
+  cairo_surface_t *overlay_ = nullptr;
+  uint64_t overlayKey_ = 0;
+  int overlayX_ = 0, overlayY_ = 0, overlayW_ = 0, overlayH_ = 0;
+
+  RenderBackend backend_;
+  bool batched_;
+  double lod_;
+  Scratch scratch_;
+  GrainSelection selection_;
+  GrainStore visible_;
+
+  ThreadPool *pool_ = nullptr;
+  std::vector<Scratch> bands_; // uno por franja (vacío: sin franjas)
+
   int width_;
   int height_;
   double margin_;
@@ -0,0 +1,94 @@
+#pragma once
+#include "histogram_magnitude_2d.hpp"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FrameJob;
+
+// Tamaño y fecha de modificación de los archivos de entrada de un frame
+struct InputFingerprint {
+  uint64_t frameSize = 0;
+  int64_t frameMtime = 0;
+  uint64_t valuesSize = 0;
+  int64_t valuesMtime = 0;
+  // El otro archivo de valores (.sxy/.ve), si alguna salida lo usa o el
+  // frame es .gfb
+  uint64_t otherSize = 0;
+  int64_t otherMtime = 0;
+
+  bool operator==(const InputFingerprint &) const = default;
+};
+
+// Manifest de una corrida en el directorio de salida
+//
+// Registra, para cada frame ya escrito, la huella de sus entradas y (en el
+// encabezado) un hash de los parámetros de render. Junto a él se guarda un
+// checkpoint con las sumas parciales del histograma global que corresponden
+// exactamente a esos frames. Una nueva corrida sobre el mismo directorio
+// omite los frames al día y continúa donde quedó una corrida interrumpida.
+//
+// Ambos archivos se escriben a un temporal y se renombran; llevan el mismo
+// número de generación, así que un corte entre las dos escrituras se
+// detecta y sólo obliga a recalcular el histograma (no a re-renderizar).
+class RunManifest {
+public:
+  RunManifest(const std::string &outputDir, uint64_t paramsHash,
+              MagnitudeHistogram &histogram, size_t checkpointEvery = 50);
+
+  // Lee el manifest previo (si existe y coinciden los parámetros)
+  void load();
+
+  // true si `job` está registrado con las mismas entradas (no verifica que
+  // el PNG siga existiendo)
+  bool isRecorded(const FrameJob &job) const;
+
+  // Restaura las sumas del histograma si el checkpoint corresponde a los
+  // frames registrados y todos ellos siguen presentes y sin cambios en
+  // `jobs`. Si no, deja manifest e histograma vacíos y devuelve false.
+  bool restoreHistogram(const std::vector<FrameJob> &jobs);
+
+  // Olvida los frames registrados y vacía el histograma, para volver a sumar
+  // todos los frames (isRecorded ya consultado sigue valiendo para el render)
+  void reset();
+
+  // Thread-safe: registra un frame terminado y suma sus puntos al fragmento
+  // del histograma del hilo (si el job lo pide). Cada `checkpointEvery`
+  // frames escribe un checkpoint.
+  void commit(const FrameJob &job, const MagnitudeHistogram::Points &points);
+
+  // Thread-safe: escribe checkpoint + manifest con lo registrado hasta ahora.
+  // Espera a los commits en curso y los frena sólo mientras junta los
+  // fragmentos del histograma, no durante la escritura.
+  void checkpoint();
+
+  size_t size() const { return done_.size(); }
+
+  static InputFingerprint fingerprint(const FrameJob &job);
+
+  // Hash estable (FNV-1a de 64 bits) de la firma de parámetros
+  static uint64_t hashParams(const std::string &signature);
+
+private:
+  using Frames = std::map<std::string, InputFingerprint, std::less<>>;
+
+  // Escribe el checkpoint (las sumas ya reducidas) y el manifest con `done`
+  void write(uint64_t generation, const Frames &done);
+
+  std::string manifestFile_;
+  std::string checkpointFile_;
+  uint64_t paramsHash_;
+  MagnitudeHistogram &histogram_;
+  size_t checkpointEvery_;
+
+  uint64_t generation_ = 0;
+  Frames done_; // frame -> huella
+  size_t sinceCheckpoint_ = 0;
+  mutable std::mutex mutex_;    // done_, generation_ y sinceCheckpoint_
+  std::shared_mutex gate_;      // commits compartido, reducción exclusiva
+  std::mutex writeMutex_;       // un checkpoint a la vez
+};
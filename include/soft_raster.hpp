@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Vista de píxeles ARGB32 premultiplicados (el formato de
+// CAIRO_FORMAT_ARGB32) sobre memoria ajena. (x0, y0) es la posición del primer
+// píxel dentro de la imagen completa: una banda o un tile se dibuja con las
+// mismas coordenadas de pantalla que la imagen entera.
+struct PixelBuffer {
+  uint32_t *data = nullptr;
+  int width = 0, height = 0;
+  int stride = 0; // en píxeles
+  int x0 = 0, y0 = 0;
+
+  uint32_t *row(int y) const {
+    return data + static_cast<ptrdiff_t>(y - y0) * stride - x0;
+  }
+};
+
+// Rasterizador por software para los granos: discos y polígonos convexos
+// rellenos con un color ARGB32 opaco (ver Colormap::packed). El antialiasing
+// es analítico: la cobertura de un píxel sale de la distancia de su centro al
+// borde, así que sólo los píxeles del contorno se mezclan uno a uno y los
+// tramos interiores se llenan con fillSpan (AVX2 o SSE2 según cómo se compile, escalar si no).
+//
+// Sigue la convención de Cairo: el píxel (i, j) cubre [i, i+1] x [j, j+1].
+namespace SoftRaster {
+
+void fillDisc(const PixelBuffer &buf, double cx, double cy, double r,
+              uint32_t color);
+
+// Vértices en coordenadas de pantalla, en cualquier orientación. Los
+// polígonos de Box2D son siempre convexos; uno cóncavo se dibuja como la
+// intersección de los semiplanos de sus aristas.
+void fillConvex(const PixelBuffer &buf, const double *xs, const double *ys,
+                size_t n, uint32_t color);
+
+// Grano de menos de un píxel: su área `area` (en píxeles) se reparte con
+// pesos bilineales entre los 2x2 píxeles cuyos centros rodean (cx, cy), y
+// cada uno se mezcla con esa cobertura. Mucho más barato que fillDisc o
+// fillConvex y con la misma tinta total mientras no se sature un píxel.
+void splat(const PixelBuffer &buf, double cx, double cy, double area,
+           uint32_t color);
+
+// Tinta total (suma de coberturas) que fillDisc deja para un disco de radio
+// `r`: más que pi r^2 en discos de menos de un píxel, por la rampa de 1 px del
+// antialiasing. Con esta área un splat tiene el mismo peso que el disco.
+double discInk(double r);
+
+// Llena `n` píxeles consecutivos con `color`
+void fillSpan(uint32_t *dst, size_t n, uint32_t color);
+
+} // namespace SoftRaster
@@ -0,0 +1,63 @@
+#pragma once
+#include "bounded_queue.hpp"
+#include "frame_pipeline.hpp"
+#include "grain_index.hpp"
+#include "image_writer.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Render por tiles para imágenes que no entran en memoria (pósters de decenas
+// de miles de píxeles por lado)
+//
+// La imagen se recorre en franjas de `tile` filas. Los tiles de una franja se
+// rasterizan en paralelo en un ThreadPool, cada uno con sólo los granos que
+// el índice espacial del frame da para su región, y se copian al buffer de
+// la franja; luego la
+// franja se filtra y comprime (también en el pool, en paralelo con los tiles
+// de las franjas siguientes) y se agrega en orden a un único PNG. Nunca hay
+// más de `ahead` franjas en memoria, así que el pico depende del ancho de la
+// imagen y del tamaño de tile, no del alto.
+class TiledRenderer {
+public:
+  TiledRenderer(const RenderSettings &settings, size_t threads);
+  ~TiledRenderer();
+
+  TiledRenderer(const TiledRenderer &) = delete;
+  TiledRenderer &operator=(const TiledRenderer &) = delete;
+
+  // Dibuja el frame (con `index`, el de `grains`) y lo escribe como PNG;
+  // false (con el error en std::cerr) si no se pudo escribir. La escala de
+  // colores es la de `settings` (valmin, valmax).
+  bool render(const GrainStore &grains, const GrainIndex &index,
+              const std::string &filename);
+
+private:
+  struct Worker; // Renderer, Canvas del tamaño de un tile y granos del tile
+
+  struct Strip {
+    std::vector<uint32_t> pixels; // `tile` filas de la imagen completa
+    std::vector<uint32_t> prev;   // última fila de la franja anterior
+    std::vector<std::future<void>> tiles;
+    std::future<void> packed;
+    PngStrip png;
+  };
+
+  void drawTile(Worker &worker, const GrainStore &grains,
+                const GrainIndex &index, int strip, int col, Strip &out);
+  void submit(const GrainStore &grains, const GrainIndex &index, int strip);
+  void drain();
+
+  RenderSettings settings_;
+  int tile_;
+  int rows_, cols_; // franjas y tiles por franja
+  ScreenTransform toScreen_;
+
+  std::vector<Strip> strips_; // anillo de `ahead` franjas
+  std::vector<std::unique_ptr<Worker>> workers_;
+  BoundedQueue<Worker *> idle_;
+  ThreadPool pool_; // último: sus hilos terminan antes que lo demás
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+struct ValueColumns;
+
+// Tabla de valores crudos (.sxy/.ve) indexada por gid
+//
+// Los ids de Box2D son densos en [0, N): las filas se guardan contiguas en
+// un único buffer con paso fijo (`stride`), y la fila de gid está en
+// values[gid * stride, gid * stride + len[gid]). Los ids negativos o muy
+// dispersos caen en un mapa de respaldo, de modo que cualquier archivo se
+// puede representar sin perder filas.
+class ValueTable {
+public:
+  // Los buffers se piden a `mem` (la arena del frame en el pipeline)
+  explicit ValueTable(
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : dense_(mem), len_(mem), sparseIndex_(mem), sparse_(mem) {}
+
+  // Agrega (o reemplaza) la fila de `gid`
+  void set(int gid, std::span<const double> row);
+
+  // Fila de `gid`; vacía si no existe
+  std::span<const double> find(int gid) const {
+    if (gid >= 0 && static_cast<size_t>(gid) < len_.size()) {
+      const int32_t n = len_[gid];
+      if (n >= 0)
+        return {dense_.data() + static_cast<size_t>(gid) * stride_,
+                static_cast<size_t>(n)};
+    }
+    // Un gid pudo entrar al respaldo antes de que el rango denso lo alcanzara
+    return sparseIndex_.empty() ? std::span<const double>{} : findSparse(gid);
+  }
+  bool contains(int gid) const;
+
+  // Reserva espacio para ids densos en [0, n) con `stride` valores por fila
+  void reserve(size_t n, size_t stride);
+  void clear();
+
+  size_t rows() const { return rows_; }
+  size_t stride() const { return stride_; }
+  bool empty() const { return rows_ == 0; }
+
+  // Construye la tabla a partir de filas CSR (p.ej. leídas de un .gfb)
+  static ValueTable fromColumns(
+      const ValueColumns &cols,
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource());
+
+private:
+  std::span<const double> findSparse(int gid) const;
+  void restride(size_t stride);
+
+  size_t stride_ = 0;
+  size_t rows_ = 0;
+  std::pmr::vector<double> dense_; // len_.size() * stride_ valores
+  std::pmr::vector<int32_t> len_;  // -1 = gid ausente
+
+  // Respaldo para ids fuera del rango denso: gid -> (offset, len) en sparse_
+  std::pmr::unordered_map<int, std::pair<uint32_t, uint32_t>> sparseIndex_;
+  std::pmr::vector<double> sparse_;
+};
@@ -11,9 +11,13 @@ if [ "$#" -lt 3 ]; then
   echo "      nombre_video sin extensión (agrega .mp4)"
   echo "      frame_rate sugeridos: 20, 25, 30."
   echo "      opacidad: intensidad de persistencia (0.0-1.0, default: 0.5)"
-  echo "      frames: número de frames a mezclar (default: 2)"
+  echo "      frames: número de frames a mezclar (default: 2; 1 = sin persistencia,"
+  echo "              p.ej. si los frames ya se mezclaron con --persist-frames)"
   echo "      pesos: pesos relativos separados por espacios (default: '1 1')"
   echo "  "
+  echo "  La extensión de las imágenes se toma de EXT (default: png), p.ej. para"
+  echo "  frames escritos con --format ppm:  EXT=ppm ./dovideo frm anim 25"
+  echo "  "
   echo "Ejemplos: "
   echo "  ./dovideo frm anim 25"
   echo "  ./dovideo frm anim 25 0.7"
@@ -32,6 +36,7 @@ fi
 OPACITY=${4:-0.5}
 FRAMES=${5:-2}
 WEIGHTS=${6:-"1 1"}
+EXT=${EXT:-png}
 
 # Validaciones básicas
 if (($(echo "$OPACITY < 0.0 || $OPACITY > 1.0" | bc -l))); then
@@ -45,7 +50,10 @@ if ! [[ "$FRAMES" =~ ^[0-9]+$ ]] || [ "$FRAMES" -lt 1 ]; then
 fi
 
 # Construir el filtro según los parámetros
-if [ "$FRAMES" -eq 2 ] && [ "$WEIGHTS" = "1 1" ]; then
+if [ "$FRAMES" -eq 1 ]; then
+  # Sin persistencia: los frames se usan tal cual
+  FILTER=""
+elif [ "$FRAMES" -eq 2 ] && [ "$WEIGHTS" = "1 1" ]; then
   # Caso simple: usar tblend para mejor rendimiento
   FILTER="-vf \"tblend=all_mode=average:all_opacity=$OPACITY\""
 else
@@ -54,7 +62,7 @@ else
 fi
 
 echo "Generando video con parámetros:"
-echo "  Prefijo: $1"
+echo "  Prefijo: $1 (*.$EXT)"
 echo "  Video: $2.mp4"
 echo "  Frame rate: $3"
 echo "  Opacidad: $OPACITY"
@@ -64,7 +72,7 @@ echo "  Filtro: $FILTER"
 echo ""
 
 # Ejecutar ffmpeg
-eval ffmpeg -framerate $3 -pattern_type glob -i \"$1_*.png\" \
+eval ffmpeg -framerate $3 -pattern_type glob -i \"$1_*.$EXT\" \
   -c:v libx264 -pix_fmt yuv420p \
   -crf 23 -preset medium \
   $FILTER \
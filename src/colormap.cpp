@@ -0,0 +1,181 @@
+#include "colormap.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ---------------- Colormaps incluidos ----------------
+// Los stops de cada colormap y su tabla, generada en tiempo de compilación
+namespace cmap_detail {
+
+constexpr std::array<ColorStop, 10> kViridisStops{{
+    {0.000, {0.267, 0.004, 0.329}},
+    {0.111, {0.283, 0.141, 0.458}},
+    {0.222, {0.254, 0.265, 0.530}},
+    {0.333, {0.207, 0.372, 0.553}},
+    {0.444, {0.153, 0.468, 0.557}},
+    {0.556, {0.122, 0.543, 0.544}},
+    {0.667, {0.173, 0.622, 0.494}},
+    {0.778, {0.337, 0.706, 0.414}},
+    {0.889, {0.592, 0.776, 0.318}},
+    {1.000, {0.993, 0.906, 0.144}}
+}};
+constexpr Colormap::Lut kViridisLut = makeLut(kViridisStops);
+
+constexpr std::array<ColorStop, 10> kInfernoStops{{
+    {0.000, {0.002, 0.000, 0.014}},
+    {0.111, {0.087, 0.016, 0.232}},
+    {0.222, {0.245, 0.033, 0.206}},
+    {0.333, {0.395, 0.068, 0.349}},
+    {0.444, {0.552, 0.105, 0.388}},
+    {0.556, {0.710, 0.167, 0.352}},
+    {0.667, {0.847, 0.257, 0.262}},
+    {0.778, {0.934, 0.391, 0.210}},
+    {0.889, {0.976, 0.568, 0.253}},
+    {1.000, {0.988, 0.998, 0.645}}
+}};
+constexpr Colormap::Lut kInfernoLut = makeLut(kInfernoStops);
+
+constexpr std::array<ColorStop, 10> kRdYlBuStops{{
+    {0.000, {0.647, 0.000, 0.149}},
+    {0.111, {0.843, 0.188, 0.153}},
+    {0.222, {0.957, 0.427, 0.263}},
+    {0.333, {0.992, 0.682, 0.380}},
+    {0.444, {0.998, 0.851, 0.561}},
+    {0.556, {0.878, 0.953, 0.973}},
+    {0.667, {0.670, 0.851, 0.914}},
+    {0.778, {0.455, 0.678, 0.820}},
+    {0.889, {0.271, 0.459, 0.706}},
+    {1.000, {0.192, 0.212, 0.584}}
+}};
+constexpr Colormap::Lut kRdYlBuLut = makeLut(kRdYlBuStops);
+
+constexpr std::array<ColorStop, 10> kGreensStops{{
+    {0.000, {0.969, 0.988, 0.961}},
+    {0.111, {0.898, 0.961, 0.878}},
+    {0.222, {0.784, 0.925, 0.753}},
+    {0.333, {0.631, 0.851, 0.608}},
+    {0.444, {0.455, 0.769, 0.463}},
+    {0.556, {0.255, 0.671, 0.306}},
+    {0.667, {0.137, 0.545, 0.271}},
+    {0.778, {0.000, 0.427, 0.173}},
+    {0.889, {0.000, 0.267, 0.106}},
+    {1.000, {0.000, 0.137, 0.055}}
+}};
+constexpr Colormap::Lut kGreensLut = makeLut(kGreensStops);
+
+constexpr std::array<ColorStop, 10> kRedsStops{{
+    {0.000, {1.000, 0.961, 0.941}},
+    {0.111, {0.996, 0.878, 0.824}},
+    {0.222, {0.988, 0.733, 0.631}},
+    {0.333, {0.988, 0.573, 0.447}},
+    {0.444, {0.984, 0.416, 0.290}},
+    {0.556, {0.937, 0.231, 0.173}},
+    {0.667, {0.796, 0.094, 0.114}},
+    {0.778, {0.647, 0.059, 0.082}},
+    {0.889, {0.404, 0.000, 0.051}},
+    {1.000, {0.220, 0.000, 0.031}}
+}};
+constexpr Colormap::Lut kRedsLut = makeLut(kRedsStops);
+
+constexpr std::array<ColorStop, 10> kWinterStops{{
+    {0.000, {0.000, 0.000, 1.000}},
+    {0.111, {0.000, 0.111, 0.944}},
+    {0.222, {0.000, 0.222, 0.889}},
+    {0.333, {0.000, 0.333, 0.833}},
+    {0.444, {0.000, 0.444, 0.778}},
+    {0.556, {0.000, 0.556, 0.722}},
+    {0.667, {0.000, 0.667, 0.667}},
+    {0.778, {0.000, 0.778, 0.611}},
+    {0.889, {0.000, 0.889, 0.556}},
+    {1.000, {0.000, 1.000, 0.500}}
+}};
+constexpr Colormap::Lut kWinterLut = makeLut(kWinterStops);
+
+constexpr std::array<ColorStop, 10> kAutumnStops{{
+    {0.000, {1.000, 0.000, 0.000}},
+    {0.111, {1.000, 0.111, 0.000}},
+    {0.222, {1.000, 0.222, 0.000}},
+    {0.333, {1.000, 0.333, 0.000}},
+    {0.444, {1.000, 0.444, 0.000}},
+    {0.556, {1.000, 0.556, 0.000}},
+    {0.667, {1.000, 0.667, 0.000}},
+    {0.778, {1.000, 0.778, 0.000}},
+    {0.889, {1.000, 0.889, 0.000}},
+    {1.000, {1.000, 1.000, 0.000}}
+}};
+constexpr Colormap::Lut kAutumnLut = makeLut(kAutumnStops);
+
+constexpr std::array<ColorStop, 10> kBluesStops{{
+    {0.000, {0.969, 0.984, 1.000}},
+    {0.111, {0.871, 0.922, 0.969}},
+    {0.222, {0.776, 0.859, 0.937}},
+    {0.333, {0.619, 0.792, 0.882}},
+    {0.444, {0.420, 0.682, 0.839}},
+    {0.556, {0.259, 0.573, 0.776}},
+    {0.667, {0.129, 0.443, 0.710}},
+    {0.778, {0.031, 0.318, 0.612}},
+    {0.889, {0.031, 0.188, 0.420}},
+    {1.000, {0.015, 0.094, 0.235}}
+}};
+constexpr Colormap::Lut kBluesLut = makeLut(kBluesStops);
+
+constexpr std::array<ColorStop, 8> kHotStops{{
+    {0.000, {0.041, 0.000, 0.000}},
+    {0.143, {0.504, 0.000, 0.000}},
+    {0.286, {1.000, 0.251, 0.000}},
+    {0.429, {1.000, 0.504, 0.000}},
+    {0.571, {1.000, 0.757, 0.000}},
+    {0.714, {1.000, 1.000, 0.251}},
+    {0.857, {1.000, 1.000, 0.504}},
+    {1.000, {1.000, 1.000, 1.000}}
+}};
+constexpr Colormap::Lut kHotLut = makeLut(kHotStops);
+
+} // namespace cmap_detail
+
+// ---------------- hashOf ----------------
+// FNV-1a sobre las entradas de la tabla
+uint64_t Colormap::hashOf(const Lut &lut) {
+  uint64_t h = 1469598103934665603ull;
+  for (uint32_t c : lut) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+// ---------------- mapColors ----------------
+void Colormap::mapColors(std::span<const double> values, double vmin,
+                         double vmax, uint32_t *out) const {
+  const double s = scale(vmin, vmax);
+  const uint32_t *lut = lut_->data();
+  const size_t n = values.size();
+  size_t i = 0;
+#if defined(__AVX2__)
+  // Cuatro valores por iteración: índice con min/max y lectura con gather.
+  // min_pd(NaN, top) devuelve `top`, igual que level()
+  const __m256d lo = _mm256_set1_pd(vmin), sc = _mm256_set1_pd(s);
+  const __m256d half = _mm256_set1_pd(0.5), zero = _mm256_setzero_pd();
+  const __m256d top = _mm256_set1_pd(kLutSize - 1);
+  for (; i + 4 <= n; i += 4) {
+    __m256d t = _mm256_loadu_pd(values.data() + i);
+    t = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(t, lo), sc), half);
+    t = _mm256_max_pd(zero, _mm256_min_pd(t, top));
+    const __m128i idx = _mm256_cvttpd_epi32(t);
+    const __m128i c =
+        _mm_i32gather_epi32(reinterpret_cast<const int *>(lut), idx, 4);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), c);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = lut[level(values[i], vmin, s)];
+}
+
+void Colormap::mapLevels(std::span<const double> values, double vmin,
+                         double vmax, uint16_t *out) const {
+  static_assert(kLutSize <= 65536, "los niveles deben caber en uint16_t");
+  const double s = scale(vmin, vmax);
+  for (size_t i = 0; i < values.size(); ++i)
+    out[i] = static_cast<uint16_t>(level(values[i], vmin, s));
+}
@@ -0,0 +1,97 @@
+// convert_frames.cpp
+// Conversor único de frames de texto (.xy + .sxy/.ve) al formato binario .gfb
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <future>
+
+#include "thread_pool.hpp"
+#include "parser.hpp"
+#include "frame_binary.hpp"
+#include "line_reader.hpp"
+
+namespace fs = std::filesystem;
+
+int main(int argc, char* argv[]) {
+    std::string inputDir = ".";
+    std::string outputDir;   // por defecto, junto a los .xy
+    bool force = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if ((a == "--dir" || a == "-d") && i + 1 < argc) { inputDir = argv[++i]; }
+        else if ((a == "--out" || a == "--output") && i + 1 < argc) { outputDir = argv[++i]; }
+        else if (a == "--force" || a == "-f") { force = true; }
+        else if (a == "--help" || a == "-h") {
+            std::cout << "Usage: " << argv[0] << " [--dir <input_dir>] [--out <out_dir>] [--force]\n\n"
+                      << "Convierte cada frm_XXX.xy[.gz|.zst] (y sus .sxy/.ve si existen) a frm_XXX"
+                      << FrameBinary::extension << ".\n"
+                      << "Sin --force, se omiten los frames cuyo .gfb es más nuevo que sus fuentes.\n";
+            return 0;
+        }
+    }
+    if (outputDir.empty()) outputDir = inputDir;
+
+    try {
+        if (!fs::exists(outputDir)) fs::create_directories(outputDir);
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] No se pudo crear output dir '" << outputDir << "': " << e.what() << "\n";
+        return 1;
+    }
+
+    size_t nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0) nthreads = 4;
+    ThreadPool pool(nthreads);
+    std::vector<std::future<bool>> futures;
+
+    for (const auto& entry : fs::directory_iterator(inputDir)) {
+        if (!entry.is_regular_file()) continue;
+        auto path = entry.path();
+        std::string name = path.filename().string();
+        auto comp = Compression::suffix(name);
+        fs::path plain = name.substr(0, name.size() - comp.size());
+        if (plain.extension() != ".xy") continue;
+
+        std::string xyFile = path.string();
+        std::string base = (path.parent_path() / plain.stem()).string();
+        std::string sxyFile = Compression::findInput(base, ".sxy");
+        std::string veFile = Compression::findInput(base, ".ve");
+        std::string outFile = fs::path(outputDir) / (plain.stem().string() + FrameBinary::extension);
+
+        futures.push_back(pool.enqueue([xyFile, sxyFile, veFile, outFile, force]() {
+            try {
+                if (!force && fs::exists(outFile)) {
+                    auto t = fs::last_write_time(outFile);
+                    bool upToDate = t >= fs::last_write_time(xyFile);
+                    for (const auto& f : {sxyFile, veFile})
+                        if (!f.empty() && fs::last_write_time(f) > t) upToDate = false;
+                    if (upToDate) return true;
+                }
+
+                FrameColumns cols;
+                if (!Parser::readXYColumns(xyFile, cols)) return false;
+                if (!sxyFile.empty()) Parser::readValueColumns(sxyFile, cols.sxy);
+                if (!veFile.empty()) Parser::readValueColumns(veFile, cols.ve);
+
+                if (!FrameBinary::write(outFile, cols)) return false;
+                std::cout << "[OK] " << outFile << "\n";
+                return true;
+            } catch (const std::exception &e) {
+                std::cerr << "[ERROR] converting " << xyFile << ": " << e.what() << "\n";
+                return false;
+            }
+        }));
+    }
+
+    int failed = 0;
+    for (auto &f : futures) {
+        if (!f.get()) ++failed;
+    }
+    if (failed) {
+        std::cerr << "[ERROR] " << failed << " frames no pudieron convertirse\n";
+        return 1;
+    }
+    std::cout << "All frames converted.\n";
+    return 0;
+}
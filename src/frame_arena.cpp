@@ -0,0 +1,71 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+constexpr std::align_val_t kBlockAlign{64};
+} // namespace
+
+FrameArena::FrameArena(size_t blockSize)
+    : blockSize_(std::max<size_t>(blockSize, 4096)) {}
+
+FrameArena::~FrameArena() {
+  for (const Block &b : blocks_)
+    ::operator delete(b.data, kBlockAlign);
+}
+
+FrameArena::Block FrameArena::newBlock(size_t bytes) {
+  const size_t size = std::max(bytes, blockSize_);
+  return {static_cast<std::byte *>(::operator new(size, kBlockAlign)), size};
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t align) {
+  for (;;) {
+    if (current_ < blocks_.size()) {
+      const Block &b = blocks_[current_];
+      const size_t start = (offset_ + align - 1) & ~(align - 1);
+      if (start + bytes <= b.size) {
+        offset_ = start + bytes;
+        return b.data + start;
+      }
+      if (current_ + 1 < blocks_.size()) {
+        ++current_;
+        offset_ = 0;
+        continue;
+      }
+    }
+    // Sin lugar: un bloque nuevo, cada vez más grande para que un frame
+    // grande converja en pocos bloques
+    blocks_.push_back(newBlock(bytes + align));
+    blockSize_ *= 2;
+    current_ = blocks_.size() - 1;
+    offset_ = 0;
+  }
+}
+
+void FrameArena::rewind() {
+  if (blocks_.size() > 1) {
+    const size_t total = capacity();
+    for (const Block &b : blocks_)
+      ::operator delete(b.data, kBlockAlign);
+    blocks_.clear();
+    blocks_.push_back(newBlock(total));
+  }
+  current_ = 0;
+  offset_ = 0;
+}
+
+size_t FrameArena::capacity() const {
+  size_t total = 0;
+  for (const Block &b : blocks_)
+    total += b.size;
+  return total;
+}
+
+size_t FrameArena::used() const {
+  size_t total = offset_;
+  for (size_t i = 0; i < current_ && i < blocks_.size(); ++i)
+    total += blocks_[i].size;
+  return total;
+}
@@ -0,0 +1,255 @@
+#include "frame_binary.hpp"
+#include "mapped_file.hpp"
+#include "parser.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char kMagic[8] = {'G', 'C', 'M', 'R', 'F', 'R', 'M', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kAlign = 64;
+
+enum : uint32_t { kHasSXY = 1u << 0, kHasVE = 1u << 1 };
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t nGrains;
+  uint64_t nVertices;
+  uint64_t sxyRows;
+  uint64_t sxyValues;
+  uint64_t veRows;
+  uint64_t veValues;
+};
+static_assert(sizeof(Header) == 64, "Header del .gfb debe ocupar 64 bytes");
+
+size_t alignUp(size_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+// ---- Escritura ----
+class SectionWriter {
+public:
+  explicit SectionWriter(std::ofstream &out) : out_(out) {}
+
+  template <typename Vec> void column(const Vec &v) {
+    const size_t bytes = v.size() * sizeof(typename Vec::value_type);
+    out_.write(reinterpret_cast<const char *>(v.data()), bytes);
+    pos_ += bytes;
+    pad();
+  }
+  void header(const Header &h) {
+    out_.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    pos_ += sizeof(h);
+    pad();
+  }
+
+private:
+  void pad() {
+    static const char zeros[kAlign] = {};
+    const size_t n = alignUp(pos_) - pos_;
+    out_.write(zeros, n);
+    pos_ += n;
+  }
+
+  std::ofstream &out_;
+  size_t pos_ = 0;
+};
+
+// ---- Lectura ----
+class SectionReader {
+public:
+  explicit SectionReader(std::string_view data) : data_(data) {}
+
+  template <typename Vec> bool column(Vec &v, uint64_t count) {
+    // `count` viene del archivo: comparar sin multiplicar (puede desbordar)
+    constexpr size_t size = sizeof(typename Vec::value_type);
+    if (pos_ > data_.size() || count > (data_.size() - pos_) / size)
+      return false;
+    const size_t bytes = static_cast<size_t>(count) * size;
+    v.resize(count);
+    if (bytes)
+      std::memcpy(v.data(), data_.data() + pos_, bytes);
+    pos_ = alignUp(pos_ + bytes);
+    return true;
+  }
+  void skip(size_t bytes) { pos_ = alignUp(pos_ + bytes); }
+
+private:
+  std::string_view data_;
+  size_t pos_ = 0;
+};
+
+// Offsets CSR que se usan para indexar: empiezan en 0, no decrecen y el
+// último no pasa de `limit`
+template <typename Vec> bool validOffsets(const Vec &offset, uint64_t limit) {
+  if (offset.empty() || offset.front() != 0 || offset.back() > limit)
+    return false;
+  for (size_t i = 1; i < offset.size(); ++i)
+    if (offset[i] < offset[i - 1])
+      return false;
+  return true;
+}
+
+bool readValues(SectionReader &in, ValueColumns &v, uint64_t rows,
+                uint64_t values, bool present) {
+  v.gid.clear();
+  v.offset.clear();
+  v.values.clear();
+  if (!present)
+    return true;
+  return in.column(v.gid, rows) && in.column(v.offset, rows + 1) &&
+         in.column(v.values, values) && validOffsets(v.offset, values);
+}
+
+void writeValues(SectionWriter &out, const ValueColumns &v) {
+  if (v.offset.empty())
+    return;
+  out.column(v.gid);
+  out.column(v.offset);
+  out.column(v.values);
+}
+
+} // namespace
+
+// ---------------- write ----------------
+bool FrameBinary::write(const std::string &filename, const FrameColumns &cols) {
+  // Se escribe a un temporal y se renombra: un .gfb nunca queda a medias
+  const std::string tmp = filename + ".tmp";
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::cerr << "Error al abrir " << tmp << "\n";
+    return false;
+  }
+
+  Header h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.flags =
+      (cols.sxy.offset.empty() ? 0u : static_cast<uint32_t>(kHasSXY)) |
+      (cols.ve.offset.empty() ? 0u : static_cast<uint32_t>(kHasVE));
+  h.nGrains = cols.size();
+  h.nVertices = cols.vx.size();
+  h.sxyRows = cols.sxy.rows();
+  h.sxyValues = cols.sxy.values.size();
+  h.veRows = cols.ve.rows();
+  h.veValues = cols.ve.values.size();
+
+  SectionWriter w(out);
+  w.header(h);
+  w.column(cols.gid);
+  w.column(cols.type);
+  w.column(cols.nv);
+  w.column(cols.vtxOffset);
+  w.column(cols.vx);
+  w.column(cols.vy);
+  w.column(cols.cx);
+  w.column(cols.cy);
+  w.column(cols.radius);
+  writeValues(w, cols.sxy);
+  writeValues(w, cols.ve);
+
+  out.close();
+  if (!out) {
+    std::cerr << "Error al escribir " << tmp << "\n";
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return std::rename(tmp.c_str(), filename.c_str()) == 0;
+}
+
+// ---------------- read ----------------
+bool FrameBinary::read(const std::string &filename, FrameColumns &cols) {
+  return read(MappedFile(filename), filename, cols);
+}
+
+bool FrameBinary::read(const MappedFile &file, const std::string &filename,
+                       FrameColumns &cols) {
+  if (!file.valid() || file.size() < sizeof(Header))
+    return false;
+
+  Header h;
+  std::memcpy(&h, file.view().data(), sizeof(h));
+  if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 ||
+      h.version != kVersion) {
+    std::cerr << "[WARN] " << filename << " no es un .gfb válido\n";
+    return false;
+  }
+
+  SectionReader in(file.view());
+  in.skip(sizeof(Header));
+  bool ok = in.column(cols.gid, h.nGrains) && in.column(cols.type, h.nGrains) &&
+            in.column(cols.nv, h.nGrains) &&
+            in.column(cols.vtxOffset, h.nGrains + 1) &&
+            in.column(cols.vx, h.nVertices) &&
+            in.column(cols.vy, h.nVertices) && in.column(cols.cx, h.nGrains) &&
+            in.column(cols.cy, h.nGrains) &&
+            in.column(cols.radius, h.nGrains) &&
+            readValues(in, cols.sxy, h.sxyRows, h.sxyValues,
+                       h.flags & kHasSXY) &&
+            readValues(in, cols.ve, h.veRows, h.veValues, h.flags & kHasVE);
+  if (!ok) {
+    std::cerr << "[WARN] " << filename << " está truncado o dañado\n";
+    return false;
+  }
+  // buildGrains indexa los vértices con vtxOffset
+  if (!validOffsets(cols.vtxOffset, h.nVertices)) {
+    std::cerr << "[WARN] " << filename
+              << " tiene offsets de vértices inválidos\n";
+    return false;
+  }
+  return true;
+}
+
+// ---------------- hasValuesFor ----------------
+bool FrameBinary::hasValuesFor(const FrameColumns &cols,
+                               const std::string &property) {
+  const ValueColumns &v =
+      Parser::valuesExtension(property) == ".ve" ? cols.ve : cols.sxy;
+  return !v.offset.empty();
+}
+
+// ---------------- buildGrains ----------------
+GrainStore FrameBinary::buildGrains(const FrameColumns &cols,
+                                    const std::string &property) {
+  GrainStore grains;
+  buildGrains(cols, property, grains);
+  return grains;
+}
+
+void FrameBinary::buildGrains(const FrameColumns &cols,
+                              const std::string &property,
+                              GrainStore &grains) {
+  const ValueColumns &vals =
+      Parser::valuesExtension(property) == ".ve" ? cols.ve : cols.sxy;
+
+  const ValueTable table = ValueTable::fromColumns(vals, grains.resource());
+
+  grains.reserve(cols.size(), cols.vx.size());
+  for (size_t i = 0; i < cols.size(); i++) {
+    const int gid = cols.gid[i];
+    const uint32_t b = cols.vtxOffset[i], e = cols.vtxOffset[i + 1];
+
+    if (gid < 0) {
+      for (uint32_t k = b; k < e; k++)
+        grains.walls.addVertex(cols.vx[k], cols.vy[k]);
+      grains.walls.close(gid, cols.type[i], -1.0);
+      continue;
+    }
+
+    double scalar = 0.0;
+    if (table.contains(gid))
+      scalar = Parser::computeProperty(property, table.find(gid));
+
+    if (cols.nv[i] == 1) {
+      grains.circles.add(gid, cols.type[i], cols.cx[i], cols.cy[i],
+                         cols.radius[i], scalar);
+    } else {
+      for (uint32_t k = b; k < e; k++)
+        grains.polygons.addVertex(cols.vx[k], cols.vy[k]);
+      grains.polygons.close(gid, cols.type[i], scalar);
+    }
+  }
+}
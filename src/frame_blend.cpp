@@ -0,0 +1,153 @@
+#include "frame_blend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// dst[i] = sum_k q[k] * src[k][i] / 256 sobre `n` bytes. Los pesos suman
+// 256, así que la suma de productos (más el redondeo) entra en 16 bits.
+void mixRow(const unsigned char *const *src, const uint16_t *q, size_t m,
+            unsigned char *dst, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 16 <= n; i += 16) {
+    __m256i acc = _mm256_set1_epi16(128);
+    for (size_t k = 0; k < m; ++k) {
+      const __m256i v = _mm256_cvtepu8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[k] + i)));
+      acc = _mm256_add_epi16(
+          acc, _mm256_mullo_epi16(v, _mm256_set1_epi16(q[k])));
+    }
+    acc = _mm256_srli_epi16(acc, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_packus_epi16(_mm256_castsi256_si128(acc),
+                                      _mm256_extracti128_si256(acc, 1)));
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i lo = _mm_set1_epi16(128), hi = lo;
+    for (size_t k = 0; k < m; ++k) {
+      const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[k] + i));
+      const __m128i w = _mm_set1_epi16(q[k]);
+      lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), w));
+      hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), w));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+                                      _mm_srli_epi16(hi, 8)));
+  }
+#endif
+  for (; i < n; ++i) {
+    unsigned acc = 128;
+    for (size_t k = 0; k < m; ++k)
+      acc += q[k] * src[k][i];
+    dst[i] = static_cast<unsigned char>(acc >> 8);
+  }
+}
+
+} // namespace
+
+// ---------------- PersistOptions ----------------
+bool PersistOptions::parseWeights(const std::string &text,
+                                  std::vector<double> &weights) {
+  std::istringstream ss(text);
+  std::vector<double> parsed;
+  double w;
+  while (ss >> w) {
+    if (!(w >= 0.0))
+      return false;
+    parsed.push_back(w);
+  }
+  if (!ss.eof() || parsed.empty() ||
+      std::all_of(parsed.begin(), parsed.end(),
+                  [](double v) { return v == 0.0; }))
+    return false;
+  weights = std::move(parsed);
+  return true;
+}
+
+// ---------------- FrameBlender ----------------
+FrameBlender::FrameBlender(const PersistOptions &options, int width,
+                           int height)
+    : options_(options), width_(width), height_(height),
+      ring_(std::max(options.frames, 1) - 1),
+      row_(static_cast<size_t>(width)) {
+  for (auto &frame : ring_)
+    frame.resize(static_cast<size_t>(width) * height);
+}
+
+// Al arrancar hay menos frames que `frames`: se mezclan los que haya, con los
+// últimos pesos (los que corresponden a los más nuevos) renormalizados
+void FrameBlender::weightsFor(size_t sources) {
+  const size_t k = ring_.size() + 1;
+  std::vector<double> w(sources);
+  double sum = 0.0;
+  for (size_t j = 0; j < sources; ++j) {
+    const size_t p = k - sources + j;
+    if (options_.weights.empty())
+      w[j] = 1.0;
+    else
+      w[j] = options_.weights[std::min(p, options_.weights.size() - 1)];
+    sum += w[j];
+  }
+
+  const double o = std::clamp(options_.opacity, 0.0, 1.0);
+  std::vector<double> eff(sources, 0.0);
+  for (size_t j = 0; j < sources; ++j)
+    eff[j] = sum > 0.0 ? o * w[j] / sum : 0.0;
+  eff.back() += sum > 0.0 ? 1.0 - o : 1.0;
+
+  q_.resize(sources);
+  int total = 0;
+  for (size_t j = 0; j < sources; ++j) {
+    q_[j] = static_cast<uint16_t>(std::lround(eff[j] * 256.0));
+    total += q_[j];
+  }
+  // El redondeo puede dejar la suma en 255 o 257: la diferencia va al peso
+  // mayor
+  auto big = std::max_element(q_.begin(), q_.end());
+  *big = static_cast<uint16_t>(*big + 256 - total);
+}
+
+void FrameBlender::blend(uint32_t *data, int stride) {
+  if (ring_.empty())
+    return;
+  const size_t w = static_cast<size_t>(width_);
+  const size_t slots = ring_.size();
+  const size_t sources = count_ + 1;
+  const size_t oldest = (head_ + slots - count_) % slots;
+  if (sources > 1) {
+    weightsFor(sources);
+    rows_.resize(sources);
+  }
+
+  for (int y = 0; y < height_; ++y) {
+    uint32_t *cur = data + static_cast<size_t>(y) * stride;
+    uint32_t *keep = ring_[head_].data() + static_cast<size_t>(y) * w;
+    if (sources == 1) {
+      std::memcpy(keep, cur, 4 * w);
+      continue;
+    }
+    for (size_t j = 0; j < count_; ++j)
+      rows_[j] = reinterpret_cast<const unsigned char *>(
+          ring_[(oldest + j) % slots].data() + static_cast<size_t>(y) * w);
+    rows_[count_] = reinterpret_cast<const unsigned char *>(cur);
+    mixRow(rows_.data(), q_.data(), sources,
+           reinterpret_cast<unsigned char *>(row_.data()), 4 * w);
+    // `keep` puede ser la fila del frame más viejo, que ya se usó
+    std::memcpy(keep, cur, 4 * w);
+    std::memcpy(cur, row_.data(), 4 * w);
+  }
+
+  head_ = (head_ + 1) % slots;
+  count_ = std::min(count_ + 1, slots);
+}
@@ -0,0 +1,842 @@
+#include "frame_pipeline.hpp"
+#include "bounded_queue.hpp"
+#include "frame_arena.hpp"
+#include "frame_binary.hpp"
+#include "grain_index.hpp"
+#include "line_reader.hpp"
+#include "parser.hpp"
+#include "renderer.hpp"
+#include "thread_pool.hpp"
+#include "tiled_renderer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <sstream>
+#include <thread>
+
+// ---------------- Memoria por frame ----------------
+// Arena y contenedores construidos sobre ella. Viaja con el frame desde el
+// parseo hasta que termina (PNG escrito y aporte al histograma sumado).
+struct FramePipeline::FrameMemory {
+  FrameArena arena;
+  std::optional<GrainStore> grains;
+  std::optional<GrainIndex> index;
+  std::optional<HistogramPoints> points;
+  std::vector<ScalarColumns> columns; // escalares de cada salida adicional
+  std::vector<char> missing; // missing[k]: la salida k no tiene datos
+  GrainSelection selection;  // de GrainIndex::centres; fuera de la arena,
+                             // conserva su capacidad entre frames
+
+  explicit FrameMemory(size_t outputs) : outputs(outputs) { reset(); }
+
+  // Los contenedores se destruyen antes de rebobinar la arena
+  void reset() {
+    grains.reset();
+    index.reset();
+    points.reset();
+    columns.clear();
+    arena.rewind();
+    grains.emplace(&arena);
+    index.emplace(&arena);
+    points.emplace(&arena);
+    for (size_t k = 0; k < outputs; ++k)
+      columns.emplace_back(&arena);
+    missing.assign(outputs, 0);
+  }
+
+private:
+  size_t outputs;
+};
+
+// Préstamo de un elemento de un pool: al destruirse lo devuelve (una
+// FrameMemory, además, se rebobina)
+template <typename T> class PoolLease {
+public:
+  PoolLease() = default;
+  PoolLease(T *item, BoundedQueue<T *> *pool) : item_(item), pool_(pool) {}
+  PoolLease(PoolLease &&o) noexcept
+      : item_(std::exchange(o.item_, nullptr)), pool_(o.pool_) {}
+  PoolLease &operator=(PoolLease &&o) noexcept {
+    std::swap(item_, o.item_);
+    std::swap(pool_, o.pool_);
+    return *this;
+  }
+  ~PoolLease() {
+    if (item_) {
+      if constexpr (requires(T &t) { t.reset(); })
+        item_->reset();
+      pool_->push(item_);
+    }
+  }
+
+  explicit operator bool() const { return item_ != nullptr; }
+  T *operator->() const { return item_; }
+  T &operator*() const { return *item_; }
+
+private:
+  T *item_ = nullptr;
+  BoundedQueue<T *> *pool_ = nullptr;
+};
+
+// ---------------- Elementos en vuelo ----------------
+struct FramePipeline::FrameInput {
+  const FrameJob *job = nullptr;
+  MappedFile frame;  // .xy (texto o comprimido) o .gfb, ya en memoria
+  MappedFile values; // .sxy/.ve (sólo texto)
+  MappedFile otherValues; // FrameJob::otherValuesFile, si hace falta
+};
+
+struct FramePipeline::ParsedFrame {
+  const FrameJob *job = nullptr;
+  MemoryLease memory; // granos, su índice y puntos del histograma
+  double vmin = 0.0, vmax = 1.0;
+};
+
+struct FramePipeline::RenderedFrame {
+  const FrameJob *job = nullptr;
+  CanvasLease canvas; // vuelve al pool cuando se escribió el PNG (sin
+                      // superficie: frame descartado, ver discard())
+  MemoryLease memory; // los puntos se suman al histograma al escribir el PNG
+  std::vector<CanvasLease> outputs; // una superficie por salida adicional
+};
+
+namespace {
+
+// Lanza `n` hilos que consumen `in` con `fn(item, result, state)`, donde
+// `state = makeState()` es propio de cada hilo (p.ej. el Renderer con su capa
+// de paredes). El último hilo en terminar cierra `out` para que la etapa
+// siguiente sepa que no llegará nada más. Cada elemento se suelta apenas se
+// procesa, para no retener su arena mientras el hilo espera el siguiente.
+template <typename In, typename Out, typename MakeState, typename Fn>
+void spawnWorkers(std::vector<std::thread> &threads, size_t n,
+                  BoundedQueue<In> &in, BoundedQueue<Out> &out,
+                  MakeState makeState, Fn fn) {
+  auto alive = std::make_shared<std::atomic<size_t>>(n);
+  for (size_t i = 0; i < n; ++i) {
+    threads.emplace_back([&in, &out, makeState, fn, alive]() mutable {
+      auto state = makeState();
+      In item;
+      while (in.pop(item)) {
+        Out result;
+        if (fn(item, result, state))
+          out.push(std::move(result));
+        item = In{};
+      }
+      if (alive->fetch_sub(1) == 1)
+        out.close();
+    });
+  }
+}
+
+// Píxeles de una superficie, para los codificadores
+ImageView viewOf(const Canvas &canvas) {
+  cairo_surface_t *surface = canvas.surface();
+  ImageView image;
+  image.data =
+      reinterpret_cast<const uint32_t *>(cairo_image_surface_get_data(surface));
+  image.width = cairo_image_surface_get_width(surface);
+  image.height = cairo_image_surface_get_height(surface);
+  image.stride = cairo_image_surface_get_stride(surface) / 4;
+  return image;
+}
+
+// Mezcla la superficie del frame con los anteriores, en su lugar
+void blendCanvas(Canvas &canvas, FrameBlender &blender) {
+  cairo_surface_t *surface = canvas.surface();
+  cairo_surface_flush(surface);
+  blender.blend(
+      reinterpret_cast<uint32_t *>(cairo_image_surface_get_data(surface)),
+      cairo_image_surface_get_stride(surface) / 4);
+  cairo_surface_mark_dirty(surface);
+}
+
+// Igual, para etapas sin estado por hilo
+template <typename In, typename Out, typename Fn>
+void spawnStage(std::vector<std::thread> &threads, size_t n,
+                BoundedQueue<In> &in, BoundedQueue<Out> &out, Fn fn) {
+  spawnWorkers(
+      threads, n, in, out, [] { return 0; },
+      [fn](In &item, Out &result, int &) mutable { return fn(item, result); });
+}
+
+} // namespace
+
+// ---------------- OutputSpec ----------------
+bool OutputSpec::parse(const std::string &text, std::string &error) {
+  // Números separados por `sep`; false si sobra o falta algo
+  auto numbers = [](const std::string &value, char sep,
+                    std::initializer_list<double *> out) {
+    const char *p = value.c_str();
+    for (double *v : out) {
+      if (v != *out.begin() && *p++ != sep)
+        return false;
+      char *end = nullptr;
+      *v = std::strtod(p, &end);
+      if (end == p)
+        return false;
+      p = end;
+    }
+    return *p == '\0';
+  };
+
+  std::istringstream in(text);
+  std::string field;
+  while (in >> field) {
+    const size_t eq = field.find('=');
+    const std::string key = field.substr(0, eq);
+    const std::string value =
+        eq == std::string::npos ? "" : field.substr(eq + 1);
+    bool ok = !value.empty();
+    if (key == "property") {
+      property = value;
+    } else if (key == "cmap") {
+      cmapName = value;
+    } else if (key == "size") {
+      double w = 0, h = 0;
+      ok = ok && numbers(value, 'x', {&w, &h}) && w >= 1 && h >= 1;
+      if (ok) {
+        width = static_cast<int>(w);
+        height = static_cast<int>(h);
+      }
+    } else if (key == "xylimits") {
+      ok = ok && numbers(value, ',', {&xmin, &xmax, &ymin, &ymax});
+    } else if (key == "vals") {
+      ok = ok && numbers(value, ',', {&valmin, &valmax});
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      error = field;
+      return false;
+    }
+  }
+  return true;
+}
+
+// ---------------- RenderSettings ----------------
+RenderSettings RenderSettings::output(size_t k) const {
+  const OutputSpec &o = outputs[k];
+  RenderSettings s = *this;
+  s.outputs.clear();
+  s.property = o.property;
+  s.cmapName = o.cmapName;
+  s.cmap = o.cmap;
+  s.width = o.width;
+  s.height = o.height;
+  s.xmin = o.xmin;
+  s.xmax = o.xmax;
+  s.ymin = o.ymin;
+  s.ymax = o.ymax;
+  s.valmin = o.valmin;
+  s.valmax = o.valmax;
+  return s;
+}
+
+std::string RenderSettings::signature() const {
+  std::ostringstream ss;
+  ss.precision(17);
+  ss << "property=" << property << ";size=" << width << 'x' << height
+     << ";margin=" << margin << ";xy=" << xmin << ',' << xmax << ',' << ymin
+     << ',' << ymax << ";vals=" << valmin << ',' << valmax
+     << ";cmap=" << cmapName
+     << ";backend=" << (backend == RenderBackend::Soft ? "soft" : "cairo")
+     << ";batched=" << batched
+     << ";format=" << EncodeOptions::formatName(encode.format);
+  if (encode.format == ImageFormat::Png)
+    ss << ";png=" << encode.pngLevel << ','
+       << EncodeOptions::filterName(encode.pngFilter);
+  if (stream.enabled())
+    ss << ";stream=" << StreamOptions::formatName(stream.format) << ','
+       << stream.fps;
+  if (tile > 0)
+    ss << ";tile=" << tile;
+  if (lod > 0.0)
+    ss << ";lod=" << lod;
+  if (persist.enabled()) {
+    ss << ";persist=" << persist.frames << ',' << persist.opacity;
+    for (double w : persist.weights)
+      ss << ',' << w;
+  }
+  for (const OutputSpec &o : outputs)
+    ss << ";output=" << o.name << ',' << o.property << ',' << o.cmapName
+       << ',' << o.width << 'x' << o.height << ',' << o.xmin << ',' << o.xmax
+       << ',' << o.ymin << ',' << o.ymax << ',' << o.valmin << ','
+       << o.valmax;
+  return ss.str();
+}
+
+// ---------------- PipelineConfig ----------------
+PipelineConfig PipelineConfig::defaults(size_t hw) {
+  if (hw == 0)
+    hw = 4;
+  PipelineConfig c;
+  // El rasterizado y la compresión PNG dominan; el parseo es liviano y la
+  // lectura sólo necesita adelantarse al resto
+  c.ioThreads = std::clamp<size_t>(hw / 8, 1, 4);
+  c.parseThreads = std::max<size_t>(1, hw / 4);
+  c.renderThreads = std::max<size_t>(1, hw / 2);
+  c.encodeThreads = std::max<size_t>(1, hw / 4);
+  return c;
+}
+
+// ---------------- FramePipeline ----------------
+FramePipeline::FramePipeline(const RenderSettings &settings,
+                             const PipelineConfig &config,
+                             MagnitudeHistogram &histogram,
+                             RunManifest *manifest, HistogramSeries *series)
+    : settings_(settings), config_(config), histogram_(histogram),
+      manifest_(manifest), series_(series) {
+  for (size_t k = 0; k < settings_.outputs.size(); ++k)
+    outputs_.push_back(settings_.output(k));
+}
+
+size_t FramePipeline::run(const std::vector<FrameJob> &jobs) {
+  auto depth = [this](size_t consumers) {
+    return config_.queueDepth ? config_.queueDepth : 2 * consumers;
+  };
+  BoundedQueue<const FrameJob *> jobQueue(depth(config_.ioThreads));
+  BoundedQueue<FrameInput> inputQueue(depth(config_.parseThreads));
+  BoundedQueue<ParsedFrame> parsedQueue(depth(config_.renderThreads));
+  BoundedQueue<RenderedFrame> renderedQueue(depth(config_.encodeThreads));
+  // Con persistencia: de la mezcla a la codificación
+  const bool tiled = settings_.tile > 0;
+  const bool persist = settings_.persist.enabled() && !tiled;
+  BoundedQueue<RenderedFrame> blendedQueue(depth(config_.encodeThreads));
+  const size_t afterBlend = persist ? blendedQueue.capacity() + 1 : 0;
+
+  // Una arena por frame que puede estar en vuelo desde el parseo: en cada
+  // hilo de parseo, rasterizado y codificación, y en las colas entre ellos
+  const size_t inFlight = config_.parseThreads + parsedQueue.capacity() +
+                          config_.renderThreads + renderedQueue.capacity() +
+                          config_.encodeThreads + afterBlend;
+
+  // Flujo ordenado: a lo sumo un frame admitido por arena, así el buffer de
+  // reorden no guarda más frames de los que el pipeline tiene en vuelo
+  std::optional<FrameStream> stream;
+  if (settings_.stream.enabled()) {
+    stream.emplace(settings_.stream, settings_.width, settings_.height,
+                   inFlight);
+    if (!stream->valid())
+      return 0;
+    stream_ = &*stream;
+  }
+
+  std::vector<std::unique_ptr<FrameMemory>> memories;
+  BoundedQueue<FrameMemory *> pool(inFlight);
+  for (size_t i = 0; i < inFlight; ++i) {
+    memories.push_back(std::make_unique<FrameMemory>(outputs_.size()));
+    pool.push(memories.back().get());
+  }
+  pool_ = &pool;
+
+  // Una superficie por frame que puede estar rasterizado a la vez: en cada
+  // hilo de rasterizado y codificación y en las colas entre ellos. Se crean
+  // una vez y pasan de frame en frame.
+  // Por tiles no hay superficies del tamaño de la imagen.
+  const size_t surfaces =
+      tiled ? 0
+            : config_.renderThreads + renderedQueue.capacity() +
+                  config_.encodeThreads + afterBlend;
+  std::vector<std::unique_ptr<Canvas>> canvasStore;
+  BoundedQueue<Canvas *> canvases(surfaces);
+  for (size_t i = 0; i < surfaces; ++i) {
+    canvasStore.push_back(
+        std::make_unique<Canvas>(settings_.width, settings_.height));
+    canvases.push(canvasStore.back().get());
+  }
+  canvases_ = &canvases;
+  // Y otras tantas por cada salida adicional, de su tamaño
+  std::vector<std::unique_ptr<BoundedQueue<Canvas *>>> outputPools;
+  for (const RenderSettings &o : outputs_) {
+    outputPools.push_back(
+        std::make_unique<BoundedQueue<Canvas *>>(surfaces));
+    for (size_t i = 0; i < surfaces; ++i) {
+      canvasStore.push_back(std::make_unique<Canvas>(o.width, o.height));
+      outputPools.back()->push(canvasStore.back().get());
+    }
+    outputCanvases_.push_back(outputPools.back().get());
+  }
+  if (persist)
+    ordered_ = &renderedQueue;
+
+  // Menos frames que hilos de rasterizado (p.ej. pocos frames de millones
+  // de granos): un hilo por frame, y cada frame se divide en franjas que se
+  // dibujan en paralelo en un pool con todos los hilos de rasterizado
+  const size_t toRender = std::count_if(
+      jobs.begin(), jobs.end(), [](const FrameJob &job) { return job.render; });
+  const bool banded =
+      !tiled && toRender > 0 && toRender < config_.renderThreads;
+  std::optional<ThreadPool> bandPool;
+  if (banded)
+    bandPool.emplace(config_.renderThreads);
+  // Dos franjas por hilo, para repartir bien las zonas con más granos
+  const int bands = banded ? static_cast<int>(
+                                 2 * ((config_.renderThreads + toRender - 1) /
+                                      toRender))
+                           : 1;
+
+  std::atomic<size_t> written{0};
+  std::vector<std::thread> threads;
+
+  spawnStage(threads, config_.ioThreads, jobQueue, inputQueue,
+             [this](const FrameJob *job, FrameInput &out) {
+               if (read(*job, out))
+                 return true;
+               discard(*job);
+               return false;
+             });
+  spawnStage(threads, config_.parseThreads, inputQueue, parsedQueue,
+             [this](FrameInput &in, ParsedFrame &out) {
+               if (parse(in, out))
+                 return true;
+               discard(*in.job);
+               return false;
+             });
+  // Por tiles: un hilo dibuja los frames de a uno y reparte sus tiles entre
+  // los hilos de rasterizado y codificación, que no forman etapas propias
+  if (tiled) {
+    threads.emplace_back([this, &parsedQueue, &written] {
+      TiledRenderer tiles(settings_,
+                          config_.renderThreads + config_.encodeThreads);
+      ParsedFrame frame;
+      while (parsedQueue.pop(frame)) {
+        if (renderTiled(frame, tiles))
+          ++written;
+        frame = ParsedFrame{};
+      }
+    });
+  }
+  const size_t renderThreads =
+      tiled ? 0 : banded ? toRender : config_.renderThreads;
+  const size_t encodeThreads = tiled ? 0 : config_.encodeThreads;
+
+  // Un Renderer por hilo y por salida: conserva la capa de paredes entre
+  // frames
+  spawnWorkers(
+      threads, renderThreads, parsedQueue, renderedQueue,
+      [this, &bandPool, bands] {
+        Renderers renderers;
+        auto add = [&](const RenderSettings &s) {
+          renderers.push_back(std::make_unique<Renderer>(
+              s.width, s.height, s.margin, s.valmin, s.valmax, s.backend,
+              s.batched, s.lod));
+          if (bandPool)
+            renderers.back()->setBands(&*bandPool, bands);
+        };
+        add(settings_);
+        for (const RenderSettings &o : outputs_)
+          add(o);
+        return renderers;
+      },
+      [this](ParsedFrame &in, RenderedFrame &out, Renderers &renderers) {
+        if (rasterize(in, out, renderers))
+          return true;
+        discard(*in.job);
+        return false;
+      });
+
+  // Persistencia: un hilo recibe los frames rasterizados en cualquier orden,
+  // los ordena por índice y mezcla cada uno con los anteriores. Sólo se
+  // admiten `window` frames desde el próximo a mezclar; cada uno retiene a lo
+  // sumo una superficie y una arena, así que el próximo siempre encuentra las
+  // suyas y la espera no traba al pipeline.
+  std::counting_semaphore<> window(
+      persist ? config_.renderThreads + renderedQueue.capacity() : 1);
+  if (persist) {
+    threads.emplace_back([this, &renderedQueue, &blendedQueue, &window] {
+      FrameBlender blender(settings_.persist, settings_.width,
+                           settings_.height);
+      std::map<size_t, RenderedFrame> waiting;
+      size_t next = 0;
+      RenderedFrame frame;
+      while (renderedQueue.pop(frame)) {
+        const size_t index = frame.job->index;
+        waiting.emplace(index, std::move(frame));
+        frame = RenderedFrame{};
+        for (auto it = waiting.begin();
+             it != waiting.end() && it->first == next; it = waiting.begin()) {
+          RenderedFrame ready = std::move(it->second);
+          waiting.erase(it);
+          ++next;
+          window.release();
+          if (!ready.canvas) {
+            if (stream_)
+              stream_->skip(ready.job->index);
+            continue;
+          }
+          blendCanvas(*ready.canvas, blender);
+          if (ready.job->write)
+            blendedQueue.push(std::move(ready));
+          else
+            complete(*ready.job, *ready.memory->points);
+        }
+      }
+      blendedQueue.close();
+    });
+  }
+
+  BoundedQueue<RenderedFrame> &encodeQueue =
+      persist ? blendedQueue : renderedQueue;
+  for (size_t i = 0; i < encodeThreads; ++i) {
+    threads.emplace_back([this, &encodeQueue, &written] {
+      ImageWriter writer(settings_.encode); // buffers y zlib propios del hilo
+      RenderedFrame frame;
+      while (encodeQueue.pop(frame)) {
+        if (encode(frame, writer))
+          ++written;
+        else
+          fail(*frame.job);
+        frame = RenderedFrame{};
+      }
+    });
+  }
+
+  for (const auto &job : jobs) {
+    if (stream_)
+      stream_->admit();
+    if (persist)
+      window.acquire();
+    jobQueue.push(&job);
+  }
+  jobQueue.close();
+
+  for (auto &t : threads)
+    t.join();
+  pool_ = nullptr;
+  canvases_ = nullptr;
+  outputCanvases_.clear();
+  ordered_ = nullptr;
+  if (stream_) {
+    stream_ = nullptr;
+    if (!stream->finish()) {
+      std::cerr << "[ERROR] writing " << settings_.stream.path << "\n";
+      return 0;
+    }
+    return stream->written();
+  }
+  return written.load();
+}
+
+// ---------------- Etapa 1: lectura ----------------
+bool FramePipeline::read(const FrameJob &job, FrameInput &out) const {
+  out.job = &job;
+  out.frame = MappedFile(job.frameFile);
+  if (!out.frame.valid()) {
+    std::cerr << "[WARN] Could not read " << job.frameFile << " (skipping)\n";
+    return false;
+  }
+  if (!job.binary) {
+    out.values = MappedFile(job.valuesFile);
+    if (!out.values.valid()) {
+      std::cerr << "[WARN] Missing paired file: " << job.valuesFile
+                << " (skipping " << job.frameFile << ")\n";
+      return false;
+    }
+    out.values.prefault();
+    if (!job.otherValuesFile.empty()) {
+      // Sin el otro archivo sólo se omiten las salidas que lo usan
+      out.otherValues = MappedFile(job.otherValuesFile);
+      if (out.otherValues.valid())
+        out.otherValues.prefault();
+      else
+        std::cerr << "[WARN] Missing paired file: " << job.otherValuesFile
+                  << " (skipping its outputs for " << job.frameFile << ")\n";
+    }
+  }
+  out.frame.prefault();
+  return true;
+}
+
+// ---------------- Etapa 2: parseo y propiedades ----------------
+bool FramePipeline::parse(FrameInput &in, ParsedFrame &out) {
+  const FrameJob &job = *in.job;
+  out.job = in.job;
+
+  FrameMemory *mem = nullptr;
+  if (!pool_->pop(mem))
+    return false;
+  out.memory = MemoryLease(mem, pool_);
+  GrainStore &grains = *mem->grains;
+  try {
+    if (job.binary) {
+      // Frame binario: columnas ya parseadas, sin texto
+      FrameColumns cols(&mem->arena);
+      if (!FrameBinary::read(in.frame, job.frameFile, cols)) {
+        std::cerr << "[WARN] Could not read " << job.frameFile
+                  << " (skipping)\n";
+        return false;
+      }
+      if (!FrameBinary::hasValuesFor(cols, settings_.property)) {
+        std::cerr << "[WARN] " << job.frameFile << " has no values for '"
+                  << settings_.property << "' (skipping)\n";
+        return false;
+      }
+      for (size_t k = 0; k < outputs_.size(); ++k)
+        if (!FrameBinary::hasValuesFor(cols, outputs_[k].property)) {
+          std::cerr << "[WARN] " << job.frameFile << " has no values for '"
+                    << outputs_[k].property << "' (skipping that output)\n";
+          mem->missing[k] = 1;
+        }
+      FrameBinary::buildGrains(cols, settings_.property, grains);
+      if (!outputs_.empty()) {
+        // Una tabla por archivo de valores, para todas las salidas que lo usan
+        outputColumns(grains, ValueTable::fromColumns(cols.sxy, &mem->arena),
+                      ".sxy", *mem);
+        outputColumns(grains, ValueTable::fromColumns(cols.ve, &mem->arena),
+                      ".ve", *mem);
+      }
+    } else {
+      auto xy = LineReader::open(std::move(in.frame), job.frameFile, &mem->arena);
+      auto values =
+          LineReader::open(std::move(in.values), job.valuesFile, &mem->arena);
+      if (!xy || !values) {
+        std::cerr << "[WARN] Could not decode " << job.frameFile
+                  << " (skipping)\n";
+        return false;
+      }
+      if (outputs_.empty()) {
+        Parser::readFrame(*xy, *values, job.frameFile, job.valuesFile,
+                          settings_.property, grains);
+      } else {
+        // Con salidas adicionales cada archivo de valores se lee una vez a
+        // una tabla, de la que salen todas las propiedades que lo usan
+        ValueTable table(&mem->arena);
+        Parser::readSXY(*values, table);
+        Parser::readXY(*xy, table, settings_.property, grains);
+        outputColumns(grains, table,
+                      Parser::valuesExtension(settings_.property), *mem);
+        if (!job.otherValuesFile.empty()) {
+          const std::string ext =
+              Parser::valuesExtension(settings_.property) == ".ve" ? ".sxy"
+                                                                   : ".ve";
+          LineReader::Ptr other;
+          if (in.otherValues.valid()) {
+            other = LineReader::open(std::move(in.otherValues),
+                                     job.otherValuesFile, &mem->arena);
+            if (!other)
+              std::cerr << "[WARN] Could not decode " << job.otherValuesFile
+                        << " (skipping its outputs)\n";
+          }
+          if (other) {
+            ValueTable otherTable(&mem->arena);
+            Parser::readSXY(*other, otherTable);
+            outputColumns(grains, otherTable, ext, *mem);
+          } else {
+            // Se dibujan las demás salidas; éstas no tienen datos
+            for (size_t k = 0; k < outputs_.size(); ++k)
+              if (Parser::valuesExtension(outputs_[k].property) == ext)
+                mem->missing[k] = 1;
+          }
+        }
+      }
+    }
+
+    if (grains.empty()) {
+      std::cerr << "[WARN] No grains parsed from " << job.frameFile << "\n";
+      return false;
+    }
+
+    // Índice espacial (cajas y grilla) para el render y el histograma
+    mem->index->build(grains);
+
+    // Recolectar datos para el histograma global
+    const GrainBox histogramRegion{histogram_.getXMin(), histogram_.getYMin(),
+                                   histogram_.getXMax(), histogram_.getYMax()};
+    mem->index->centres(grains, histogramRegion, histogram_.areaWeighted(),
+                        *mem->points, mem->selection);
+
+    // PNG ya al día: el frame sólo hacía falta para el histograma
+    if (!job.render) {
+      complete(job, *mem->points);
+      return false;
+    }
+
+    // Determine vmin/vmax from grains' scalars
+    double vmin = 0.0, vmax = 1.0;
+    grains.scalarRange(vmin, vmax);
+    if (vmin == vmax) { // avoid degenerate range
+      double eps = std::abs(vmin) * 1e-6 + 1e-6;
+      vmin -= eps;
+      vmax += eps;
+    }
+    out.vmin = vmin;
+    out.vmax = vmax;
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "[ERROR] processing " << job.frameFile << ": " << e.what()
+              << "\n";
+    return false;
+  }
+}
+
+void FramePipeline::outputColumns(const GrainStore &grains,
+                                  const ValueTable &values,
+                                  const std::string &extension,
+                                  FrameMemory &mem) const {
+  std::vector<std::string> properties;
+  std::vector<ScalarColumns *> columns;
+  for (size_t k = 0; k < outputs_.size(); ++k)
+    if (!mem.missing[k] &&
+        Parser::valuesExtension(outputs_[k].property) == extension) {
+      properties.push_back(outputs_[k].property);
+      columns.push_back(&mem.columns[k]);
+    }
+  if (!columns.empty())
+    Parser::computeColumns(grains, values, properties, columns);
+}
+
+// ---------------- Etapa 3: rasterizado ----------------
+bool FramePipeline::rasterize(ParsedFrame &in, RenderedFrame &out,
+                              Renderers &renderers) const {
+  const RenderSettings &s = settings_;
+  out.job = in.job;
+
+  Canvas *canvas = nullptr;
+  if (!canvases_->pop(canvas))
+    return false;
+  out.canvas = CanvasLease(canvas, canvases_);
+  try {
+    renderers[0]->render(*canvas, *in.memory->grains, &*in.memory->index,
+                         in.vmin, in.vmax, s.xmin, s.xmax, s.ymin, s.ymax,
+                         s.cmap);
+  } catch (const std::exception &e) {
+    std::cerr << "[ERROR] rendering " << in.job->frameFile << ": " << e.what()
+              << "\n";
+    return false;
+  }
+
+  // Salidas adicionales: los mismos granos con los escalares de cada una (sin
+  // superficie las que no tienen datos en este frame)
+  GrainStore &grains = *in.memory->grains;
+  for (size_t k = 0; k < outputs_.size(); ++k) {
+    if (in.memory->missing[k]) {
+      out.outputs.emplace_back();
+      continue;
+    }
+    Canvas *extra = nullptr;
+    if (!outputCanvases_[k]->pop(extra))
+      return false;
+    out.outputs.emplace_back(extra, outputCanvases_[k]);
+    const RenderSettings &o = outputs_[k];
+    ScalarColumns &column = in.memory->columns[k];
+    swapScalars(grains, column);
+    bool ok = true;
+    try {
+      renderers[k + 1]->render(*extra, grains, &*in.memory->index, o.valmin,
+                               o.valmax, o.xmin, o.xmax, o.ymin, o.ymax,
+                               o.cmap);
+    } catch (const std::exception &e) {
+      std::cerr << "[ERROR] rendering " << in.job->frameFile << " ("
+                << o.property << "): " << e.what() << "\n";
+      ok = false;
+    }
+    swapScalars(grains, column);
+    if (!ok)
+      return false;
+  }
+  out.memory = std::move(in.memory);
+  return true;
+}
+
+// ---------------- Etapa 4: codificación y escritura ----------------
+bool FramePipeline::encode(RenderedFrame &in, ImageWriter &writer) {
+  const ImageView image = viewOf(*in.canvas);
+  if (stream_) {
+    // El frame se escribe en su turno; el histograma no depende del orden
+    stream_->submit(in.job->index, image);
+    complete(*in.job, *in.memory->points);
+    std::cout << "[OK] " << in.job->frameFile << " -> frame " << in.job->index
+              << "\n";
+    return true;
+  }
+  if (!writer.write(image, in.job->outFile)) {
+    std::cerr << "[ERROR] writing " << in.job->outFile << "\n";
+    return false;
+  }
+  for (size_t k = 0; k < in.outputs.size(); ++k) {
+    const std::string &file = in.job->outputFiles[k];
+    if (!in.outputs[k]) {
+      // Una imagen vieja no debe pasar por la de este frame: sin ella, el
+      // frame no queda al día y se vuelve a intentar en la próxima corrida
+      std::error_code ec;
+      std::filesystem::remove(file, ec);
+      continue;
+    }
+    if (!writer.write(viewOf(*in.outputs[k]), file)) {
+      std::cerr << "[ERROR] writing " << file << "\n";
+      return false;
+    }
+  }
+  complete(*in.job, *in.memory->points);
+  std::cout << "[OK] " << in.job->outFile;
+  for (size_t k = 0; k < in.outputs.size(); ++k)
+    if (in.outputs[k])
+      std::cout << ", " << in.job->outputFiles[k];
+  std::cout << "\n";
+  return true;
+}
+
+// ---------------- Etapas 3 y 4 por tiles ----------------
+bool FramePipeline::renderTiled(ParsedFrame &in, TiledRenderer &tiles) {
+  const FrameJob &job = *in.job;
+  try {
+    if (!tiles.render(*in.memory->grains, *in.memory->index, job.outFile)) {
+      std::cerr << "[ERROR] writing " << job.outFile << "\n";
+      fail(job);
+      return false;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "[ERROR] rendering " << job.frameFile << ": " << e.what()
+              << "\n";
+    fail(job);
+    return false;
+  }
+  complete(job, *in.memory->points);
+  std::cout << "[OK] " << job.outFile << "\n";
+  return true;
+}
+
+// Un frame que no llega a codificarse libera su turno en la mezcla (que a su
+// vez lo libera en el flujo) o directamente en el flujo, y en las ventanas
+// de tiempo
+void FramePipeline::discard(const FrameJob &job) {
+  if (series_)
+    series_->skip(job.index);
+  if (ordered_) {
+    RenderedFrame skipped;
+    skipped.job = &job;
+    ordered_->push(std::move(skipped));
+  } else if (stream_) {
+    stream_->skip(job.index);
+  }
+}
+
+// Un frame dibujado que no se pudo escribir: no llega a complete(), así que
+// se descuenta de sus ventanas de tiempo y libera su turno en el flujo
+void FramePipeline::fail(const FrameJob &job) {
+  if (series_)
+    series_->skip(job.index);
+  if (stream_)
+    stream_->skip(job.index);
+}
+
+// El aporte al histograma se suma recién cuando el frame terminó, así un
+// checkpoint del manifest contiene exactamente los frames registrados
+void FramePipeline::complete(const FrameJob &job,
+                             const HistogramPoints &points) {
+  const MagnitudeHistogram::Points columns{points.x, points.y, points.value,
+                                           points.halfW, points.halfH};
+  if (manifest_)
+    manifest_->commit(job, columns);
+  else if (job.histogram)
+    histogram_.addPoints(columns);
+  if (series_)
+    series_->add(job.index, columns);
+}
@@ -0,0 +1,161 @@
+#include "frame_stream.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+// ---------------- StreamOptions ----------------
+bool StreamOptions::parseFormat(const std::string &name, StreamFormat &format) {
+  if (name == "y4m")
+    format = StreamFormat::Y4m;
+  else if (name == "rgb" || name == "raw")
+    format = StreamFormat::Rgb;
+  else
+    return false;
+  return true;
+}
+
+const char *StreamOptions::formatName(StreamFormat format) {
+  return format == StreamFormat::Rgb ? "rgb" : "y4m";
+}
+
+// ---------------- FrameStream ----------------
+FrameStream::FrameStream(const StreamOptions &options, int width, int height,
+                         size_t window)
+    : options_(options), width_(width), height_(height),
+      window_(static_cast<std::ptrdiff_t>(window ? window : 1)) {
+  if (options_.path == "-") {
+    file_ = stdout;
+  } else {
+    file_ = std::fopen(options_.path.c_str(), "wb");
+    ownsFile_ = true;
+    if (!file_) {
+      std::cerr << "Error al abrir " << options_.path << "\n";
+      return;
+    }
+  }
+  if (options_.format == StreamFormat::Y4m) {
+    // 4:4:4 progresivo, píxeles cuadrados
+    if (std::fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width_,
+                     height_, options_.fps) < 0)
+      failed_ = true;
+  }
+}
+
+FrameStream::~FrameStream() {
+  if (file_ && ownsFile_)
+    std::fclose(file_);
+}
+
+void FrameStream::admit() { window_.acquire(); }
+
+void FrameStream::submit(size_t index, const ImageView &image) {
+  Slot slot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!spare_.empty()) {
+      slot.bytes = std::move(spare_.back());
+      spare_.pop_back();
+    }
+  }
+  convert(image, slot.bytes);
+  deposit(index, std::move(slot));
+}
+
+void FrameStream::skip(size_t index) { deposit(index, Slot{}); }
+
+// Deja el frame en el buffer de reorden. Si nadie está escribiendo, este hilo
+// escribe todos los frames consecutivos disponibles desde next_; el fwrite va
+// fuera del lock, así que los demás hilos sólo depositan y siguen.
+void FrameStream::deposit(size_t index, Slot slot) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_.emplace(index, std::move(slot));
+  if (writing_)
+    return;
+  writing_ = true;
+  for (auto it = pending_.begin(); it != pending_.end() && it->first == next_;
+       it = pending_.begin()) {
+    Slot ready = std::move(it->second);
+    pending_.erase(it);
+    lock.unlock();
+
+    const bool present = !ready.bytes.empty();
+    if (present && !failed_ &&
+        std::fwrite(ready.bytes.data(), 1, ready.bytes.size(), file_) !=
+            ready.bytes.size()) {
+      std::cerr << "Error al escribir " << options_.path << "\n";
+      failed_ = true;
+    }
+
+    lock.lock();
+    ++next_;
+    if (present) {
+      ++written_;
+      spare_.push_back(std::move(ready.bytes));
+    }
+    window_.release();
+  }
+  writing_ = false;
+  idle_.notify_all();
+}
+
+bool FrameStream::finish() {
+  if (!file_)
+    return false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return !writing_; });
+  if (!pending_.empty()) {
+    std::cerr << "[WARN] " << pending_.size()
+              << " frames sin escribir en el flujo\n";
+  }
+  if (std::fflush(file_) != 0)
+    failed_ = true;
+  if (ownsFile_) {
+    if (std::fclose(file_) != 0)
+      failed_ = true;
+    file_ = nullptr;
+  }
+  return !failed_;
+}
+
+// Y4M: "FRAME\n" y los planos Y, Cb, Cr completos (BT.601, rango limitado,
+// la matriz que ffmpeg supone por defecto). RGB: RGB24 empaquetado.
+void FrameStream::convert(const ImageView &image,
+                          std::vector<unsigned char> &out) const {
+  const size_t plane = static_cast<size_t>(image.width) * image.height;
+  if (options_.format == StreamFormat::Rgb) {
+    out.resize(3 * plane);
+    unsigned char *d = out.data();
+    for (int y = 0; y < image.height; ++y) {
+      const uint32_t *px = image.data + static_cast<size_t>(y) * image.stride;
+      for (int x = 0; x < image.width; ++x) {
+        *d++ = (px[x] >> 16) & 0xff;
+        *d++ = (px[x] >> 8) & 0xff;
+        *d++ = px[x] & 0xff;
+      }
+    }
+    return;
+  }
+
+  static constexpr char kFrame[] = "FRAME\n";
+  constexpr size_t header = sizeof(kFrame) - 1;
+  out.resize(header + 3 * plane);
+  std::copy(kFrame, kFrame + header, out.begin());
+  unsigned char *Y = out.data() + header;
+  unsigned char *U = Y + plane;
+  unsigned char *V = U + plane;
+  for (int y = 0; y < image.height; ++y) {
+    const uint32_t *px = image.data + static_cast<size_t>(y) * image.stride;
+    for (int x = 0; x < image.width; ++x) {
+      const int r = (px[x] >> 16) & 0xff;
+      const int g = (px[x] >> 8) & 0xff;
+      const int b = px[x] & 0xff;
+      *Y++ = static_cast<unsigned char>(
+          ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+      *U++ = static_cast<unsigned char>(
+          ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+      *V++ = static_cast<unsigned char>(
+          ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+  }
+}
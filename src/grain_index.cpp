@@ -0,0 +1,255 @@
+#include "grain_index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+// Caja vacía: no toca ninguna región
+constexpr GrainBox kEmpty{kInf, kInf, -kInf, -kInf};
+
+// Lado máximo de la grilla, en celdas
+constexpr int kMaxCells = 4096;
+
+// Celda de la coordenada `v` en una fila de `n` celdas de lado `cell` que
+// empieza en `origin`, recortada a la fila (NaN cae en la primera)
+int cellIndex(double v, double origin, double cell, int n) {
+  const double k = (v - origin) / cell;
+  return k > 0.0 ? static_cast<int>(std::min(k, n - 1.0)) : 0;
+}
+
+// Medio lado del cuadrado con el área de un círculo de radio 1: sqrt(pi) / 2
+constexpr double kHalfSquare = 0.88622692545275801365;
+
+// Área del polígono `i` (fórmula del área de Gauss)
+double polygonArea(const PolygonColumns &p, size_t i) {
+  const uint32_t b = p.offset[i], e = p.offset[i + 1];
+  double twice = 0.0;
+  for (uint32_t k = b, prev = e - 1; k < e; prev = k++)
+    twice += p.vx[prev] * p.vy[k] - p.vx[k] * p.vy[prev];
+  return std::abs(twice) / 2.0;
+}
+
+// Cajas de los polígonos; `seen(box)` recibe las no vacías
+template <typename Seen>
+void polygonBoxes(const PolygonColumns &p, std::pmr::vector<GrainBox> &boxes,
+                  Seen &&seen) {
+  boxes.resize(p.size());
+  forEachPolygon(p, [&](size_t i, uint32_t b, uint32_t e) {
+    if (b == e) {
+      boxes[i] = kEmpty;
+      return;
+    }
+    auto [x0, x1] = std::minmax_element(p.vx.begin() + b, p.vx.begin() + e);
+    auto [y0, y1] = std::minmax_element(p.vy.begin() + b, p.vy.begin() + e);
+    boxes[i] = {*x0, *y0, *x1, *y1};
+    seen(boxes[i]);
+  });
+}
+
+} // namespace
+
+GrainIndex::GrainIndex(std::pmr::memory_resource *mem)
+    : circleBoxes_(mem), polygonBoxes_(mem), wallBoxes_(mem), start_(mem),
+      items_(mem) {}
+
+void GrainIndex::clear() {
+  circleBoxes_.clear();
+  polygonBoxes_.clear();
+  wallBoxes_.clear();
+  bounds_ = {0, 0, -1, -1};
+  cols_ = rows_ = 0;
+  reach_ = 0.0;
+  start_.clear();
+  items_.clear();
+}
+
+// ---------------- Construcción ----------------
+void GrainIndex::build(const GrainStore &grains) {
+  clear();
+
+  // Cajas, caja total, tamaño medio de grano y el mayor medio lado
+  GrainBox all = kEmpty;
+  double extent = 0.0, side = 0.0;
+  size_t n = 0;
+  auto grow = [&](const GrainBox &b) {
+    all.x0 = std::min(all.x0, b.x0);
+    all.y0 = std::min(all.y0, b.y0);
+    all.x1 = std::max(all.x1, b.x1);
+    all.y1 = std::max(all.y1, b.y1);
+    const double bw = b.x1 - b.x0, bh = b.y1 - b.y0;
+    extent += bw + bh;
+    side = std::max(side, std::max(bw, bh));
+    ++n;
+  };
+  const CircleColumns &c = grains.circles;
+  circleBoxes_.resize(c.size());
+  for (size_t i = 0; i < c.size(); ++i) {
+    circleBoxes_[i] = {c.x[i] - c.r[i], c.y[i] - c.r[i], c.x[i] + c.r[i],
+                       c.y[i] + c.r[i]};
+    grow(circleBoxes_[i]);
+  }
+  polygonBoxes(grains.polygons, polygonBoxes_, grow);
+  polygonBoxes(grains.walls, wallBoxes_, [](const GrainBox &) {});
+  if (n == 0)
+    return;
+  bounds_ = all;
+  reach_ = side / 2.0;
+
+  // Celdas del doble del grano medio, o más grandes si los granos están
+  // dispersos: unos cuatro granos por celda, y la grilla entra en la caché
+  const double w = all.x1 - all.x0, h = all.y1 - all.y0;
+  cell_ = 2.0 * std::max(extent / static_cast<double>(2 * n),
+                         std::sqrt(w * h / static_cast<double>(n)));
+  cell_ = std::max({cell_, w / (kMaxCells - 1), h / (kMaxCells - 1)});
+  if (!(cell_ > 0.0))
+    cell_ = 1.0;
+  cols_ = static_cast<int>(w / cell_) + 1;
+  rows_ = static_cast<int>(h / cell_) + 1;
+
+  // Cada grano va a la celda de su centro (grilla "suelta": las consultas se
+  // agrandan en reach_). Dos pasadas: contar por celda y repartir (CSR).
+  std::pmr::vector<uint32_t> cellOf(start_.get_allocator());
+  cellOf.reserve(n);
+  auto centreCell = [&](const GrainBox &b) {
+    const int cx = cellIndex((b.x0 + b.x1) / 2, all.x0, cell_, cols_);
+    const int cy = cellIndex((b.y0 + b.y1) / 2, all.y0, cell_, rows_);
+    return static_cast<uint32_t>(cy) * cols_ + cx;
+  };
+  start_.assign(static_cast<size_t>(cols_) * rows_ + 1, 0);
+  for (const GrainBox &b : circleBoxes_)
+    cellOf.push_back(centreCell(b));
+  for (const GrainBox &b : polygonBoxes_)
+    if (b.x0 <= b.x1)
+      cellOf.push_back(centreCell(b));
+  for (uint32_t cell : cellOf)
+    ++start_[cell + 1];
+  for (size_t k = 1; k < start_.size(); ++k)
+    start_[k] += start_[k - 1];
+
+  items_.resize(n);
+  std::pmr::vector<uint32_t> fill(start_.begin(), start_.end() - 1,
+                                  start_.get_allocator());
+  size_t k = 0;
+  for (uint32_t i = 0; i < circleBoxes_.size(); ++i)
+    items_[fill[cellOf[k++]]++] = i;
+  for (uint32_t i = 0; i < polygonBoxes_.size(); ++i)
+    if (polygonBoxes_[i].x0 <= polygonBoxes_[i].x1)
+      items_[fill[cellOf[k++]]++] = i | kPolygon;
+}
+
+void GrainIndex::cellRange(const GrainBox &b, int &cx0, int &cy0, int &cx1,
+                           int &cy1) const {
+  cx0 = cellIndex(b.x0, bounds_.x0, cell_, cols_);
+  cx1 = cellIndex(b.x1, bounds_.x0, cell_, cols_);
+  cy0 = cellIndex(b.y0, bounds_.y0, cell_, rows_);
+  cy1 = cellIndex(b.y1, bounds_.y0, cell_, rows_);
+}
+
+// ---------------- Consultas ----------------
+void GrainIndex::query(const GrainBox &region, GrainSelection &out) const {
+  out.circles.clear();
+  out.polygons.clear();
+  out.walls.clear();
+  for (uint32_t i = 0; i < wallBoxes_.size(); ++i)
+    if (wallBoxes_[i].touches(region))
+      out.walls.push_back(i);
+  if (cols_ == 0 || !region.touches(bounds_))
+    return;
+
+  // Un grano que toca la región tiene el centro a menos de reach_ de ella
+  const GrainBox loose{region.x0 - reach_, region.y0 - reach_,
+                       region.x1 + reach_, region.y1 + reach_};
+  int qx0, qy0, qx1, qy1;
+  cellRange(loose, qx0, qy0, qx1, qy1);
+  const size_t visited = static_cast<size_t>(qx1 - qx0 + 1) * (qy1 - qy0 + 1);
+
+  // Si la región cubre buena parte de la grilla, recorrer las cajas en orden
+  // es más barato que visitar celdas y ordenar
+  if (2 * visited >= static_cast<size_t>(cols_) * rows_) {
+    for (uint32_t i = 0; i < circleBoxes_.size(); ++i)
+      if (circleBoxes_[i].touches(region))
+        out.circles.push_back(i);
+    for (uint32_t i = 0; i < polygonBoxes_.size(); ++i)
+      if (polygonBoxes_[i].touches(region))
+        out.polygons.push_back(i);
+    return;
+  }
+
+  for (int cy = qy0; cy <= qy1; ++cy) {
+    const size_t row = static_cast<size_t>(cy) * cols_;
+    for (uint32_t k = start_[row + qx0]; k < start_[row + qx1 + 1]; ++k) {
+      const uint32_t item = items_[k];
+      const uint32_t i = item & ~kPolygon;
+      if (item & kPolygon) {
+        if (polygonBoxes_[i].touches(region))
+          out.polygons.push_back(i);
+      } else if (circleBoxes_[i].touches(region)) {
+        out.circles.push_back(i);
+      }
+    }
+  }
+  std::sort(out.circles.begin(), out.circles.end());
+  std::sort(out.polygons.begin(), out.polygons.end());
+}
+
+void GrainIndex::centres(const GrainStore &grains, const GrainBox &region,
+                         bool footprints, HistogramPoints &out,
+                         GrainSelection &scratch) const {
+  const CircleColumns &c = grains.circles;
+  const PolygonColumns &p = grains.polygons;
+  auto circle = [&](uint32_t i) {
+    if (!footprints)
+      return out.add(c.x[i], c.y[i], c.scalar[i]);
+    const double half = c.r[i] * kHalfSquare;
+    out.add(c.x[i], c.y[i], c.scalar[i], half, half);
+  };
+  auto polygon = [&](uint32_t i) {
+    const GrainBox &b = polygonBoxes_[i];
+    const double cx = (b.x0 + b.x1) / 2.0, cy = (b.y0 + b.y1) / 2.0;
+    if (!footprints)
+      return out.add(cx, cy, p.scalar[i]);
+    const double box = (b.x1 - b.x0) * (b.y1 - b.y0);
+    const double s = box > 0.0 ? std::sqrt(polygonArea(p, i) / box) : 0.0;
+    out.add(cx, cy, p.scalar[i], (b.x1 - b.x0) / 2.0 * s,
+            (b.y1 - b.y0) / 2.0 * s);
+  };
+
+  if (region.contains(bounds_)) {
+    out.reserve(out.size() + c.size() + p.size(), footprints);
+    for (uint32_t i = 0; i < c.size(); ++i)
+      circle(i);
+    for (uint32_t i = 0; i < p.size(); ++i)
+      if (p.offset[i] != p.offset[i + 1])
+        polygon(i);
+    return;
+  }
+  query(region, scratch);
+  out.reserve(out.size() + scratch.circles.size() + scratch.polygons.size(),
+              footprints);
+  for (uint32_t i : scratch.circles)
+    circle(i);
+  for (uint32_t i : scratch.polygons)
+    polygon(i);
+}
+
+// ---------------- Copia ----------------
+void copySelection(const GrainStore &from, const GrainSelection &sel,
+                   GrainStore &to) {
+  to.clear();
+  const CircleColumns &c = from.circles;
+  for (uint32_t i : sel.circles)
+    to.circles.add(c.gid[i], c.type[i], c.x[i], c.y[i], c.r[i], c.scalar[i]);
+  auto copyPolygons = [](const PolygonColumns &p,
+                         const std::vector<uint32_t> &in, PolygonColumns &dst) {
+    for (uint32_t i : in) {
+      for (uint32_t k = p.offset[i]; k < p.offset[i + 1]; ++k)
+        dst.addVertex(p.vx[k], p.vy[k]);
+      dst.close(p.gid[i], p.type[i], p.scalar[i]);
+    }
+  };
+  copyPolygons(from.polygons, sel.polygons, to.polygons);
+  copyPolygons(from.walls, sel.walls, to.walls);
+}
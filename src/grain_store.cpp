@@ -0,0 +1,110 @@
+#include "grain_store.hpp"
+#include <algorithm>
+
+// ---------------- ScreenTransform ----------------
+ScreenTransform ScreenTransform::fit(int width, int height, double margin,
+                                     double xmin, double xmax, double ymin,
+                                     double ymax) {
+  // Corregir rangos si están invertidos
+  if (xmax < xmin)
+    std::swap(xmax, xmin);
+  if (ymax < ymin)
+    std::swap(ymax, ymin);
+
+  // Calcular escalas manteniendo relación de aspecto
+  double scaleX = (width - 2 * margin) / (xmax - xmin);
+  double scaleY = (height - 2 * margin) / (ymax - ymin);
+  double scale = std::min(scaleX, scaleY);
+
+  // Calcular offsets para centrar
+  double offsetX = 0, offsetY = 0;
+  if (scaleX > scaleY) {
+    // Espacio sobrante a los lados (formato horizontal)
+    offsetX = (width - 2 * margin - (xmax - xmin) * scale) / 2;
+  } else {
+    // Espacio sobrante arriba/abajo (formato vertical)
+    offsetY = (height - 2 * margin - (ymax - ymin) * scale) / 2;
+  }
+
+  ScreenTransform t;
+  t.scale = scale;
+  t.xmin = xmin;
+  t.ymin = ymin;
+  t.left = margin + offsetX;
+  t.bottom = height - margin - offsetY;
+  return t;
+}
+
+// ---------------- Puntos del histograma ----------------
+void HistogramPoints::clear() {
+  x.clear();
+  y.clear();
+  value.clear();
+  halfW.clear();
+  halfH.clear();
+}
+
+void HistogramPoints::reserve(size_t n, bool footprints) {
+  x.reserve(n);
+  y.reserve(n);
+  value.reserve(n);
+  if (footprints) {
+    halfW.reserve(n);
+    halfH.reserve(n);
+  }
+}
+
+// ---------------- Columnas ----------------
+void CircleColumns::clear() {
+  gid.clear();
+  type.clear();
+  x.clear();
+  y.clear();
+  r.clear();
+  scalar.clear();
+}
+
+void PolygonColumns::clear() {
+  gid.clear();
+  type.clear();
+  offset.assign(1, 0);
+  vx.clear();
+  vy.clear();
+  scalar.clear();
+}
+
+// ---------------- GrainStore ----------------
+void GrainStore::clear() {
+  circles.clear();
+  polygons.clear();
+  walls.clear();
+}
+
+void GrainStore::reserve(size_t grains, size_t vertices) {
+  circles.gid.reserve(grains);
+  circles.type.reserve(grains);
+  circles.x.reserve(grains);
+  circles.y.reserve(grains);
+  circles.r.reserve(grains);
+  circles.scalar.reserve(grains);
+  polygons.vx.reserve(vertices);
+  polygons.vy.reserve(vertices);
+}
+
+bool GrainStore::scalarRange(double &vmin, double &vmax) const {
+  if (empty())
+    return false;
+  vmin = 1e300;
+  vmax = -1e300;
+  auto scan = [&](const std::pmr::vector<double> &s) {
+    for (double v : s) {
+      vmin = std::min(vmin, v);
+      vmax = std::max(vmax, v);
+    }
+  };
+  scan(circles.scalar);
+  scan(polygons.scalar);
+  scan(walls.scalar);
+  return true;
+}
+
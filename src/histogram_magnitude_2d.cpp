@@ -3,26 +3,50 @@
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
+#include <cstdio>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// Ids de instancia para la caché de fragmento de cada hilo
+std::atomic<uint64_t> next_id{1};
+
+// Con menos celdas juntar dos fragmentos no paga lanzar un hilo
+constexpr size_t kParallelCells = 65536;
+}
 
-// MagnitudeHistogram::MagnitudeHistogram(int bins_x, int bins_y, 
-//                                    double xmin, double xmax, 
-//                                    double ymin, double ymax)
 MagnitudeHistogram::MagnitudeHistogram(double xmin, double xmax, double ymin, double ymax)
     : bins_x_(xmax - xmin), bins_y_(ymax - ymin)
     , xmin_(xmin), xmax_(xmax), ymin_(ymin), ymax_(ymax)
     , cell_width_(1.0)
     , cell_height_(1.0)
-    // , cell_width_((xmax - xmin) / bins_x)
-    // , cell_height_((ymax - ymin) / bins_y)
-    , magnitude_sums_(bins_y_, std::vector<double>(bins_x_, 0.0))
-    , counts_(bins_y_, std::vector<int>(bins_x_, 0))
-    , averages_(bins_y_, std::vector<double>(bins_x_, 0.0)) {
+    , magnitude_sums_(static_cast<size_t>(bins_x_) * bins_y_, 0.0)
+    , weights_(magnitude_sums_.size(), 0.0)
+    , counts_(magnitude_sums_.size(), 0)
+    , averages_(magnitude_sums_.size(), 0.0)
+    , id_(next_id++) {
 }
 
-void MagnitudeHistogram::addPoint(double x, double y, double magnitude) {
+MagnitudeHistogram::MagnitudeHistogram(int bins_x, int bins_y, 
+                                       double xmin, double xmax, 
+                                       double ymin, double ymax)
+    : bins_x_(std::max(bins_x, 1)), bins_y_(std::max(bins_y, 1))
+    , xmin_(xmin), xmax_(xmax), ymin_(ymin), ymax_(ymax)
+    , cell_width_((xmax - xmin) / bins_x_)
+    , cell_height_((ymax - ymin) / bins_y_)
+    , magnitude_sums_(static_cast<size_t>(bins_x_) * bins_y_, 0.0)
+    , weights_(magnitude_sums_.size(), 0.0)
+    , counts_(magnitude_sums_.size(), 0)
+    , averages_(magnitude_sums_.size(), 0.0)
+    , id_(next_id++) {
+}
+
+int MagnitudeHistogram::cellOf(double x, double y) const {
     // Solo procesar puntos dentro del rango
     if (x < xmin_ || x > xmax_ || y < ymin_ || y > ymax_) {
-        return;
+        return -1;
     }
     
     int i = static_cast<int>((y - ymin_) / cell_height_);
@@ -31,46 +55,211 @@ void MagnitudeHistogram::addPoint(double x, double y, double magnitude) {
     // Asegurar que estamos dentro de los límites
     i = std::clamp(i, 0, bins_y_ - 1);
     j = std::clamp(j, 0, bins_x_ - 1);
+    return i * bins_x_ + j;
+}
+
+// ---------------- Binning ----------------
+template <typename Hit>
+void MagnitudeHistogram::scan(const Points& points, std::vector<int32_t>& scratch, Hit&& hit) const {
+    if (area_weighted_) {
+        scanAreas(points, hit);
+        return;
+    }
+    const size_t n = points.x.size();
+    const double* xs = points.x.data();
+    const double* ys = points.y.data();
+    const double* values = points.value.data();
     
-    std::lock_guard<std::mutex> lock(mutex_);
-    magnitude_sums_[i][j] += magnitude;
-    counts_[i][j]++;
+    // Pasada 1: la celda de cada punto (como cellOf), sin saltos para que el
+    // compilador la vectorice sobre toda la columna
+    scratch.resize(n);
+    int32_t* cell = scratch.data();
+    const double last_j = bins_x_ - 1, last_i = bins_y_ - 1;
+    for (size_t k = 0; k < n; ++k) {
+        const double x = xs[k], y = ys[k];
+        const double fx = (x - xmin_) / cell_width_;
+        const double fy = (y - ymin_) / cell_height_;
+        const bool inside = x >= xmin_ && x <= xmax_ && y >= ymin_ && y <= ymax_;
+        const int32_t j = static_cast<int32_t>(fx > 0.0 ? std::min(fx, last_j) : 0.0);
+        const int32_t i = static_cast<int32_t>(fy > 0.0 ? std::min(fy, last_i) : 0.0);
+        cell[k] = inside ? i * bins_x_ + j : -1;
+    }
+    
+    // Pasada 2: en orden
+    for (size_t k = 0; k < n; ++k) {
+        if (cell[k] >= 0) hit(static_cast<uint32_t>(cell[k]), 1.0, values[k]);
+    }
 }
 
-void MagnitudeHistogram::addPoints(const std::vector<std::tuple<double, double, double>>& points) {
-    std::lock_guard<std::mutex> lock(mutex_);
+template <typename Hit>
+void MagnitudeHistogram::scanAreas(const Points& points, Hit& hit) const {
+    // Largo de la intersección de la huella con cada columna y cada fila
+    std::vector<double> wx(bins_x_), wy(bins_y_);
     
-    for (const auto& point : points) {
-        double x = std::get<0>(point);
-        double y = std::get<1>(point);
-        double magnitude = std::get<2>(point);
+    const size_t n = points.x.size();
+    for (size_t k = 0; k < n; ++k) {
+        // Huella recortada al rango; sin área (o NaN) no aporta
+        const double x0 = std::max(points.x[k] - points.half_w[k], xmin_);
+        const double x1 = std::min(points.x[k] + points.half_w[k], xmax_);
+        const double y0 = std::max(points.y[k] - points.half_h[k], ymin_);
+        const double y1 = std::min(points.y[k] + points.half_h[k], ymax_);
+        if (!(x0 < x1 && y0 < y1)) continue;
         
-        if (x < xmin_ || x > xmax_ || y < ymin_ || y > ymax_) {
-            continue;
+        const int j0 = std::min(static_cast<int>((x0 - xmin_) / cell_width_), bins_x_ - 1);
+        const int j1 = std::min(static_cast<int>((x1 - xmin_) / cell_width_), bins_x_ - 1);
+        const int i0 = std::min(static_cast<int>((y0 - ymin_) / cell_height_), bins_y_ - 1);
+        const int i1 = std::min(static_cast<int>((y1 - ymin_) / cell_height_), bins_y_ - 1);
+        // La última columna (fila) llega hasta xmax (ymax), como en cellOf
+        for (int j = j0; j <= j1; ++j) {
+            const double lo = std::max(x0, xmin_ + j * cell_width_);
+            const double hi = j == bins_x_ - 1 ? x1 : std::min(x1, xmin_ + (j + 1) * cell_width_);
+            wx[j] = std::max(hi - lo, 0.0);
+        }
+        for (int i = i0; i <= i1; ++i) {
+            const double lo = std::max(y0, ymin_ + i * cell_height_);
+            const double hi = i == bins_y_ - 1 ? y1 : std::min(y1, ymin_ + (i + 1) * cell_height_);
+            wy[i] = std::max(hi - lo, 0.0);
         }
         
-        int i = static_cast<int>((y - ymin_) / cell_height_);
-        int j = static_cast<int>((x - xmin_) / cell_width_);
-        
-        i = std::clamp(i, 0, bins_y_ - 1);
-        j = std::clamp(j, 0, bins_x_ - 1);
-        
-        magnitude_sums_[i][j] += magnitude;
-        counts_[i][j]++;
+        // Cada fila es un tramo contiguo de celdas
+        const double value = points.value[k];
+        for (int i = i0; i <= i1; ++i) {
+            if (wy[i] <= 0.0) continue;
+            const uint32_t row = static_cast<uint32_t>(i) * bins_x_;
+            for (int j = j0; j <= j1; ++j) {
+                const double w = wy[i] * wx[j];
+                if (w > 0.0) hit(row + j, w, value);
+            }
+        }
     }
 }
 
-void MagnitudeHistogram::computeAverages() {
+void MagnitudeHistogram::accumulate(const Points& points, double* sums, double* weights, int* counts,
+                                    std::vector<int32_t>& scratch) const {
+    scan(points, scratch, [&](uint32_t c, double w, double value) {
+        sums[c] += w * value;
+        weights[c] += w;
+        counts[c]++;
+    });
+}
+
+void MagnitudeHistogram::moments(const Points& points, Moments& out) const {
+    // Vaciar sólo lo que tocó el frame anterior
+    const size_t cells = magnitude_sums_.size();
+    out.weights.resize(cells, 0.0);
+    out.means.resize(cells, 0.0);
+    out.m2.resize(cells, 0.0);
+    out.counts.resize(cells, 0);
+    for (uint32_t c : out.cells) {
+        out.weights[c] = out.means[c] = out.m2[c] = 0.0;
+        out.counts[c] = 0;
+    }
+    out.cells.clear();
+    
+    // Welford pesado (West): media y suma de cuadrados de las desviaciones
+    scan(points, out.scratch, [&](uint32_t c, double w, double value) {
+        if (out.counts[c]++ == 0) out.cells.push_back(c);
+        out.weights[c] += w;
+        const double d = value - out.means[c];
+        out.means[c] += d * w / out.weights[c];
+        out.m2[c] += w * d * (value - out.means[c]);
+    });
+}
+
+MagnitudeHistogram::Shard& MagnitudeHistogram::shard() {
+    // Caché de una entrada: un hilo casi siempre suma al mismo histograma
+    thread_local uint64_t cached_id = 0;
+    thread_local Shard* cached = nullptr;
+    if (cached_id == id_) return *cached;
+
+    const std::thread::id self = std::this_thread::get_id();
     std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(shards_.begin(), shards_.end(),
+                           [&](const auto& s) { return s->owner == self; });
+    if (it == shards_.end()) {
+        auto s = std::make_unique<Shard>();
+        s->owner = self;
+        s->sums.assign(magnitude_sums_.size(), 0.0);
+        s->weights.assign(magnitude_sums_.size(), 0.0);
+        s->counts.assign(magnitude_sums_.size(), 0);
+        shards_.push_back(std::move(s));
+        it = shards_.end() - 1;
+    }
+    cached_id = id_;
+    cached = it->get();
+    return *cached;
+}
+
+void MagnitudeHistogram::addPoint(double x, double y, double magnitude) {
+    const int c = cellOf(x, y);
+    if (c < 0) return;
+    Shard& s = shard();
+    s.sums[c] += magnitude;
+    s.weights[c] += 1.0;
+    s.counts[c]++;
+    s.dirty = true;
+}
+
+void MagnitudeHistogram::addPoints(const Points& points) {
+    if (points.x.empty()) return;
+    Shard& s = shard();
+    accumulate(points, s.sums.data(), s.weights.data(), s.counts.data(), s.scratch);
+    s.dirty = true;
+}
+
+void MagnitudeHistogram::reduce() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Shard*> dirty;
+    for (auto& s : shards_) {
+        if (s->dirty) dirty.push_back(s.get());
+    }
     
-    for (int i = 0; i < bins_y_; ++i) {
-        for (int j = 0; j < bins_x_; ++j) {
-            if (counts_[i][j] > 0) {
-                averages_[i][j] = magnitude_sums_[i][j] / counts_[i][j];
+    // Suma `from` a `to` y deja `from` en cero
+    auto merge = [](double* to_sums, double* to_weights, int* to_counts, Shard& from) {
+        const size_t n = from.sums.size();
+        for (size_t c = 0; c < n; ++c) {
+            to_sums[c] += from.sums[c];
+            to_weights[c] += from.weights[c];
+            to_counts[c] += from.counts[c];
+        }
+        std::fill(from.sums.begin(), from.sums.end(), 0.0);
+        std::fill(from.weights.begin(), from.weights.end(), 0.0);
+        std::fill(from.counts.begin(), from.counts.end(), 0);
+        from.dirty = false;
+    };
+    
+    // Árbol por pares: en cada nivel los pares son independientes
+    const bool parallel = magnitude_sums_.size() >= kParallelCells;
+    for (size_t step = 1; step < dirty.size(); step *= 2) {
+        std::vector<std::future<void>> level;
+        for (size_t k = 0; k + step < dirty.size(); k += 2 * step) {
+            Shard& to = *dirty[k];
+            Shard& from = *dirty[k + step];
+            auto job = [&merge, &to, &from] {
+                merge(to.sums.data(), to.weights.data(), to.counts.data(), from);
+            };
+            if (parallel) {
+                level.push_back(std::async(std::launch::async, job));
             } else {
-                averages_[i][j] = std::numeric_limits<double>::quiet_NaN();
+                job();
             }
         }
+        for (auto& f : level) f.get();
+    }
+    if (!dirty.empty()) {
+        merge(magnitude_sums_.data(), weights_.data(), counts_.data(), *dirty.front());
+    }
+}
+
+void MagnitudeHistogram::computeAverages() {
+    reduce();
+    
+    for (size_t c = 0; c < averages_.size(); ++c) {
+        if (weights_[c] > 0.0) {
+            averages_[c] = magnitude_sums_[c] / weights_[c];
+        } else {
+            averages_[c] = std::numeric_limits<double>::quiet_NaN();
+        }
     }
     averages_computed_ = true;
 }
@@ -82,7 +271,7 @@ double MagnitudeHistogram::getAverage(int i, int j) const {
     if (i < 0 || i >= bins_y_ || j < 0 || j >= bins_x_) {
         return std::numeric_limits<double>::quiet_NaN();
     }
-    return averages_[i][j];
+    return averages_[static_cast<size_t>(i) * bins_x_ + j];
 }
 
 void MagnitudeHistogram::saveForMatplotlib(const std::string& filename) const {
@@ -101,6 +290,7 @@ void MagnitudeHistogram::saveForMatplotlib(const std::string& filename) const {
     file << "# Bins: " << bins_x_ << " " << bins_y_ << "\n";
     file << "# X-range: " << xmin_ << " " << xmax_ << "\n";
     file << "# Y-range: " << ymin_ << " " << ymax_ << "\n";
+    if (area_weighted_) file << "# Weighting: area\n";
     
     // Guardar datos en formato grid
     file << std::fixed << std::setprecision(6);
@@ -108,7 +298,7 @@ void MagnitudeHistogram::saveForMatplotlib(const std::string& filename) const {
         for (int j = 0; j < bins_x_; ++j) {
             double center_x = xmin_ + (j + 0.5) * cell_width_;
             double center_y = ymin_ + (i + 0.5) * cell_height_;
-            double magnitude = averages_[i][j];
+            double magnitude = averages_[static_cast<size_t>(i) * bins_x_ + j];
             
             file << center_x << " " << center_y << " " << magnitude << "\n";
         }
@@ -136,8 +326,9 @@ void MagnitudeHistogram::saveCSV(const std::string& filename) const {
         for (int j = 0; j < bins_x_; ++j) {
             double center_x = xmin_ + (j + 0.5) * cell_width_;
             double center_y = ymin_ + (i + 0.5) * cell_height_;
-            double magnitude = averages_[i][j];
-            int count = counts_[i][j];
+            size_t c = static_cast<size_t>(i) * bins_x_ + j;
+            double magnitude = averages_[c];
+            int count = counts_[c];
             
             file << center_x << "," << center_y << "," << magnitude << "," << count << "\n";
         }
@@ -145,3 +336,92 @@ void MagnitudeHistogram::saveCSV(const std::string& filename) const {
     
     file.close();
 }
+
+// ---------------- Checkpoint ----------------
+namespace {
+constexpr char kStateMagic[8] = {'G', 'C', 'M', 'R', 'H', 'S', 'T', '2'};
+
+struct StateHeader {
+    char magic[8];
+    uint64_t generation;
+    int32_t bins_x, bins_y;
+    double xmin, xmax, ymin, ymax;
+    double cell_width, cell_height;
+    int32_t area_weighted, reserved;
+};
+}
+
+void MagnitudeHistogram::saveState(const std::string& filename, uint64_t generation) const {
+    StateHeader h{};
+    std::copy(std::begin(kStateMagic), std::end(kStateMagic), h.magic);
+    h.generation = generation;
+    h.bins_x = bins_x_;
+    h.bins_y = bins_y_;
+    h.xmin = xmin_; h.xmax = xmax_;
+    h.ymin = ymin_; h.ymax = ymax_;
+    h.cell_width = cell_width_; h.cell_height = cell_height_;
+    h.area_weighted = area_weighted_;
+
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file: " + tmp);
+        }
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.write(reinterpret_cast<const char*>(magnitude_sums_.data()), magnitude_sums_.size() * sizeof(double));
+        file.write(reinterpret_cast<const char*>(weights_.data()), weights_.size() * sizeof(double));
+        file.write(reinterpret_cast<const char*>(counts_.data()), counts_.size() * sizeof(int));
+        if (!file) {
+            throw std::runtime_error("Cannot write file: " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Cannot replace file: " + filename);
+    }
+}
+
+bool MagnitudeHistogram::loadState(const std::string& filename, uint64_t generation) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    StateHeader h{};
+    if (!file.read(reinterpret_cast<char*>(&h), sizeof(h))) return false;
+    if (!std::equal(std::begin(kStateMagic), std::end(kStateMagic), h.magic) ||
+        h.generation != generation || h.bins_x != bins_x_ || h.bins_y != bins_y_ ||
+        h.xmin != xmin_ || h.xmax != xmax_ || h.ymin != ymin_ || h.ymax != ymax_ ||
+        h.cell_width != cell_width_ || h.cell_height != cell_height_ ||
+        h.area_weighted != static_cast<int32_t>(area_weighted_)) {
+        return false;
+    }
+
+    std::vector<double> sums(magnitude_sums_.size());
+    std::vector<double> weights(weights_.size());
+    std::vector<int> counts(counts_.size());
+    file.read(reinterpret_cast<char*>(sums.data()), sums.size() * sizeof(double));
+    file.read(reinterpret_cast<char*>(weights.data()), weights.size() * sizeof(double));
+    file.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(int));
+    if (!file || file.peek() != std::char_traits<char>::eof()) return false;
+
+    clear();
+    magnitude_sums_ = std::move(sums);
+    weights_ = std::move(weights);
+    counts_ = std::move(counts);
+    return true;
+}
+
+void MagnitudeHistogram::clear() {
+    std::fill(magnitude_sums_.begin(), magnitude_sums_.end(), 0.0);
+    std::fill(weights_.begin(), weights_.end(), 0.0);
+    std::fill(counts_.begin(), counts_.end(), 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& s : shards_) {
+        if (!s->dirty) continue;
+        std::fill(s->sums.begin(), s->sums.end(), 0.0);
+        std::fill(s->weights.begin(), s->weights.end(), 0.0);
+        std::fill(s->counts.begin(), s->counts.end(), 0);
+        s->dirty = false;
+    }
+    averages_computed_ = false;
+}
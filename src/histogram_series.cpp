@@ -0,0 +1,167 @@
+#include "histogram_series.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+HistogramSeries::HistogramSeries(const MagnitudeHistogram &grid, size_t frames,
+                                 size_t window, size_t stride,
+                                 const std::string &dir)
+    : grid_(grid), frames_(frames), window_(std::max<size_t>(window, 1)),
+      stride_(std::clamp<size_t>(stride, 1, window_)), dir_(dir) {
+  // La última ventana puede quedar corta, pero nunca contenida en la anterior
+  windows_ = frames_ == 0 ? 0
+             : frames_ <= window_
+                 ? 1
+                 : (frames_ - window_ + stride_ - 1) / stride_ + 1;
+  closed_.assign(windows_, false);
+
+  std::error_code ec;
+  fs::create_directories(dir_, ec);
+  const std::string file = (fs::path(dir_) / "windows.csv").string();
+  index_.open(file, std::ios::trunc);
+  if (!index_)
+    std::cerr << "[ERROR] writing " << file << "\n";
+  index_ << "window,first_frame,last_frame,frames,file\n" << std::flush;
+}
+
+size_t HistogramSeries::end(size_t k) const {
+  return std::min(k * stride_ + window_, frames_);
+}
+
+bool HistogramSeries::range(size_t frame, size_t &first, size_t &last) const {
+  if (frame >= frames_ || windows_ == 0)
+    return false;
+  first = frame >= window_ ? (frame - window_) / stride_ + 1 : 0;
+  last = std::min(frame / stride_, windows_ - 1);
+  return first <= last;
+}
+
+template <typename Merge>
+void HistogramSeries::markLocked(size_t frame, size_t first, size_t last,
+                                 Closed &closed, Merge &&merge) {
+  for (size_t k = first; k <= last; ++k) {
+    if (closed_[k])
+      continue;
+    std::unique_ptr<Window> &w = open_[k];
+    if (!w) {
+      const size_t cells = static_cast<size_t>(grid_.getBinsX()) *
+                           static_cast<size_t>(grid_.getBinsY());
+      w = std::make_unique<Window>();
+      w->pending = end(k) - begin(k);
+      w->seen.assign(w->pending, false);
+      w->weights.assign(cells, 0.0);
+      w->means.assign(cells, 0.0);
+      w->m2.assign(cells, 0.0);
+      w->counts.assign(cells, 0);
+    }
+    if (w->seen[frame - begin(k)])
+      continue;
+    w->seen[frame - begin(k)] = true;
+    merge(*w);
+    if (--w->pending > 0)
+      continue;
+    closed_[k] = true;
+    closed.emplace_back(k, std::move(w));
+    open_.erase(k);
+  }
+}
+
+// ---------------- Frames ----------------
+void HistogramSeries::add(size_t frame,
+                          const MagnitudeHistogram::Points &points) {
+  size_t first, last;
+  if (!range(frame, first, last))
+    return;
+
+  // Momentos del frame fuera del lock; adentro sólo se combinan las celdas
+  // tocadas
+  thread_local MagnitudeHistogram::Moments m;
+  grid_.moments(points, m);
+
+  Closed closed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    markLocked(frame, first, last, closed, [&](Window &w) {
+      ++w.frames;
+      for (uint32_t c : m.cells) {
+        // Chan et al.: combinar (W_a, media_a, M2_a) con (W_b, media_b, M2_b)
+        const double wa = w.weights[c], wb = m.weights[c];
+        const double total = wa + wb;
+        const double d = m.means[c] - w.means[c];
+        w.means[c] += d * wb / total;
+        w.m2[c] += m.m2[c] + d * d * wa * wb / total;
+        w.weights[c] = total;
+        w.counts[c] += m.counts[c];
+      }
+    });
+  }
+  for (const auto &[k, w] : closed)
+    write(k, *w);
+}
+
+void HistogramSeries::skip(size_t frame) {
+  size_t first, last;
+  if (!range(frame, first, last))
+    return;
+  Closed closed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    markLocked(frame, first, last, closed, [](Window &) {});
+  }
+  for (const auto &[k, w] : closed)
+    write(k, *w);
+}
+
+void HistogramSeries::finish() {
+  std::map<size_t, std::unique_ptr<Window>> rest;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rest.swap(open_);
+    for (const auto &entry : rest)
+      closed_[entry.first] = true;
+  }
+  for (const auto &[k, w] : rest)
+    write(k, *w);
+}
+
+// ---------------- Salida ----------------
+void HistogramSeries::write(size_t k, const Window &w) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "window_%05zu.csv", k);
+  const std::string file = (fs::path(dir_) / name).string();
+  {
+    std::ofstream out(file, std::ios::trunc);
+    // Varianza pesada de población: M2 / suma de pesos
+    out << "x_center,y_center,mean,variance,weight,count\n";
+    out << std::fixed << std::setprecision(6);
+    const int bx = grid_.getBinsX(), by = grid_.getBinsY();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (int i = 0; i < by; ++i) {
+      for (int j = 0; j < bx; ++j) {
+        const size_t c = static_cast<size_t>(i) * bx + j;
+        const double weight = w.weights[c];
+        out << grid_.getXMin() + (j + 0.5) * grid_.getCellWidth() << ","
+            << grid_.getYMin() + (i + 0.5) * grid_.getCellHeight() << ","
+            << (weight > 0.0 ? w.means[c] : nan) << ","
+            << (weight > 0.0 ? w.m2[c] / weight : nan) << "," << weight
+            << "," << w.counts[c] << "\n";
+      }
+    }
+    if (!out) {
+      std::cerr << "[ERROR] writing " << file << "\n";
+      return;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  index_ << k << "," << begin(k) << "," << end(k) - 1 << "," << w.frames
+         << "," << name << "\n"
+         << std::flush;
+}
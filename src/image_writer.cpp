@@ -0,0 +1,529 @@
+#include "image_writer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+// Canales de un píxel ARGB32 opaco
+inline unsigned char red(uint32_t p) { return (p >> 16) & 0xff; }
+inline unsigned char green(uint32_t p) { return (p >> 8) & 0xff; }
+inline unsigned char blue(uint32_t p) { return p & 0xff; }
+
+void putBE32(std::vector<unsigned char> &out, uint32_t v) {
+  out.push_back(v >> 24);
+  out.push_back(v >> 16);
+  out.push_back(v >> 8);
+  out.push_back(v);
+}
+
+// ---- PNG ----
+constexpr unsigned char kPngSignature[8] = {0x89, 'P',  'N',  'G',
+                                            '\r', '\n', 0x1a, '\n'};
+
+// Agrega un chunk cuyo contenido ya está en out[start..]: se le antepone el
+// largo y tipo y se le agrega el CRC
+void closeChunk(std::vector<unsigned char> &out, size_t start) {
+  const size_t len = out.size() - start - 8;
+  out[start] = len >> 24;
+  out[start + 1] = len >> 16;
+  out[start + 2] = len >> 8;
+  out[start + 3] = len;
+  const uLong crc =
+      crc32(0, out.data() + start + 4, static_cast<uInt>(len + 4));
+  putBE32(out, static_cast<uint32_t>(crc));
+}
+
+size_t openChunk(std::vector<unsigned char> &out, const char type[4]) {
+  const size_t start = out.size();
+  out.insert(out.end(), 4, 0); // largo, se completa al cerrar
+  out.insert(out.end(), type, type + 4);
+  return start;
+}
+
+inline unsigned char paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+// Aplica el filtro `f` (0..4) a `row` con la fila anterior `prev`; dst[0] es
+// el byte de tipo de filtro
+void filterRow(int f, const unsigned char *row, const unsigned char *prev,
+               size_t n, unsigned char *dst) {
+  constexpr size_t bpp = 3;
+  dst[0] = static_cast<unsigned char>(f);
+  unsigned char *d = dst + 1;
+  switch (f) {
+  case 0:
+    std::memcpy(d, row, n);
+    break;
+  case 1:
+    for (size_t i = 0; i < n; ++i)
+      d[i] = row[i] - (i >= bpp ? row[i - bpp] : 0);
+    break;
+  case 2:
+    for (size_t i = 0; i < n; ++i)
+      d[i] = row[i] - prev[i];
+    break;
+  case 3:
+    for (size_t i = 0; i < n; ++i)
+      d[i] = row[i] - ((i >= bpp ? row[i - bpp] : 0) + prev[i]) / 2;
+    break;
+  case 4:
+    for (size_t i = 0; i < n; ++i)
+      d[i] = row[i] - paeth(i >= bpp ? row[i - bpp] : 0, prev[i],
+                            i >= bpp ? prev[i - bpp] : 0);
+    break;
+  }
+}
+
+// Suma de los bytes filtrados como valores con signo (menor = más compresible)
+uint64_t filterCost(const unsigned char *d, size_t n) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    sum += static_cast<uint64_t>(std::abs(static_cast<int>(
+        static_cast<signed char>(d[i]))));
+  return sum;
+}
+
+// Fila ARGB32 -> RGB
+void toRgb(const uint32_t *px, size_t w, unsigned char *row) {
+  for (size_t x = 0; x < w; ++x) {
+    row[3 * x] = red(px[x]);
+    row[3 * x + 1] = green(px[x]);
+    row[3 * x + 2] = blue(px[x]);
+  }
+}
+
+// Filtra `row` (n bytes RGB) según `filter` y devuelve la fila filtrada, con
+// el byte de tipo adelante, que queda en uno de los `filtered` (n + 1 bytes)
+const unsigned char *applyFilter(PngFilter filter, const unsigned char *row,
+                                 const unsigned char *prev, size_t n,
+                                 std::vector<unsigned char> (&filtered)[5]) {
+  int best = 0;
+  switch (filter) {
+  case PngFilter::None:
+    best = 0;
+    break;
+  case PngFilter::Sub:
+    best = 1;
+    break;
+  case PngFilter::Up:
+    best = 2;
+    break;
+  case PngFilter::Paeth:
+    best = 4;
+    break;
+  case PngFilter::Adaptive: {
+    uint64_t bestCost = UINT64_MAX;
+    for (int f = 0; f < 5; ++f) {
+      filterRow(f, row, prev, n, filtered[f].data());
+      const uint64_t cost = filterCost(filtered[f].data() + 1, n);
+      if (cost < bestCost) {
+        bestCost = cost;
+        best = f;
+      }
+    }
+    return filtered[best].data();
+  }
+  }
+  filterRow(best, row, prev, n, filtered[best].data());
+  return filtered[best].data();
+}
+
+// Firma y encabezado IHDR: 8 bits por canal, RGB, deflate, filtros estándar,
+// sin entrelazado
+void pngHeader(std::vector<unsigned char> &out, int width, int height) {
+  out.insert(out.end(), std::begin(kPngSignature), std::end(kPngSignature));
+  const size_t chunk = openChunk(out, "IHDR");
+  putBE32(out, width);
+  putBE32(out, height);
+  out.insert(out.end(), {8, 2, 0, 0, 0});
+  closeChunk(out, chunk);
+}
+
+// ---- QOI ----
+constexpr unsigned char kQoiOpIndex = 0x00;
+constexpr unsigned char kQoiOpDiff = 0x40;
+constexpr unsigned char kQoiOpLuma = 0x80;
+constexpr unsigned char kQoiOpRun = 0xc0;
+constexpr unsigned char kQoiOpRgb = 0xfe;
+
+} // namespace
+
+// ---------------- EncodeOptions ----------------
+const char *EncodeOptions::extension() const {
+  switch (format) {
+  case ImageFormat::Qoi:
+    return ".qoi";
+  case ImageFormat::Ppm:
+    return ".ppm";
+  default:
+    return ".png";
+  }
+}
+
+bool EncodeOptions::parseFormat(const std::string &name, ImageFormat &format) {
+  if (name == "png")
+    format = ImageFormat::Png;
+  else if (name == "qoi")
+    format = ImageFormat::Qoi;
+  else if (name == "ppm")
+    format = ImageFormat::Ppm;
+  else
+    return false;
+  return true;
+}
+
+bool EncodeOptions::parseFilter(const std::string &name, PngFilter &filter) {
+  if (name == "none")
+    filter = PngFilter::None;
+  else if (name == "sub")
+    filter = PngFilter::Sub;
+  else if (name == "up")
+    filter = PngFilter::Up;
+  else if (name == "paeth")
+    filter = PngFilter::Paeth;
+  else if (name == "adaptive")
+    filter = PngFilter::Adaptive;
+  else
+    return false;
+  return true;
+}
+
+const char *EncodeOptions::formatName(ImageFormat format) {
+  switch (format) {
+  case ImageFormat::Qoi:
+    return "qoi";
+  case ImageFormat::Ppm:
+    return "ppm";
+  default:
+    return "png";
+  }
+}
+
+const char *EncodeOptions::filterName(PngFilter filter) {
+  switch (filter) {
+  case PngFilter::None:
+    return "none";
+  case PngFilter::Sub:
+    return "sub";
+  case PngFilter::Up:
+    return "up";
+  case PngFilter::Paeth:
+    return "paeth";
+  default:
+    return "adaptive";
+  }
+}
+
+// ---------------- ImageWriter ----------------
+ImageWriter::ImageWriter(const EncodeOptions &options) : options_(options) {
+  if (options_.format != ImageFormat::Png)
+    return;
+  zs_ = std::make_unique<z_stream_s>();
+  std::memset(zs_.get(), 0, sizeof(z_stream_s));
+  if (deflateInit(zs_.get(), std::clamp(options_.pngLevel, 0, 9)) != Z_OK)
+    throw std::runtime_error("No se pudo inicializar zlib");
+}
+
+ImageWriter::~ImageWriter() {
+  if (zs_)
+    deflateEnd(zs_.get());
+}
+
+bool ImageWriter::write(const ImageView &image, const std::string &filename) {
+  const std::vector<unsigned char> &bytes = encode(image);
+  FILE *f = std::fopen(filename.c_str(), "wb");
+  if (!f) {
+    std::cerr << "Error al abrir " << filename << "\n";
+    return false;
+  }
+  const bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) ==
+                  bytes.size();
+  if (std::fclose(f) != 0 || !ok) {
+    std::cerr << "Error al escribir " << filename << "\n";
+    return false;
+  }
+  return true;
+}
+
+const std::vector<unsigned char> &ImageWriter::encode(const ImageView &image) {
+  out_.clear();
+  switch (options_.format) {
+  case ImageFormat::Png:
+    encodePng(image);
+    break;
+  case ImageFormat::Qoi:
+    encodeQoi(image);
+    break;
+  case ImageFormat::Ppm:
+    encodePpm(image);
+    break;
+  }
+  return out_;
+}
+
+// ---------------- PNG ----------------
+// RGB de 8 bits, un único IDAT. Las filas se filtran y se pasan a deflate de a
+// una, directamente sobre el buffer de salida.
+void ImageWriter::encodePng(const ImageView &image) {
+  const size_t w = static_cast<size_t>(image.width);
+  const size_t n = 3 * w;
+  row_.resize(n);
+  prev_.assign(n, 0);
+  for (auto &f : filtered_)
+    f.resize(n + 1);
+
+  pngHeader(out_, image.width, image.height);
+  size_t chunk = openChunk(out_, "IDAT");
+  z_stream &zs = *zs_;
+  deflateReset(&zs);
+  // La salida de deflate va directo a out_, que arranca con la cota de
+  // deflateBound y sólo crece si hiciera falta
+  const size_t dataStart = out_.size();
+  out_.resize(dataStart +
+              deflateBound(&zs, static_cast<uLong>((n + 1) * image.height)));
+  auto pump = [&](const unsigned char *data, size_t len, int flush) {
+    zs.next_in = const_cast<unsigned char *>(data);
+    zs.avail_in = static_cast<uInt>(len);
+    for (;;) {
+      if (out_.size() == dataStart + zs.total_out)
+        out_.resize(out_.size() + out_.size() / 2 + 1024);
+      zs.next_out = out_.data() + dataStart + zs.total_out;
+      zs.avail_out = static_cast<uInt>(out_.size() - dataStart - zs.total_out);
+      const int r = deflate(&zs, flush);
+      if (flush == Z_FINISH ? r == Z_STREAM_END
+                            : zs.avail_in == 0 && zs.avail_out > 0)
+        break;
+    }
+  };
+
+  for (int y = 0; y < image.height; ++y) {
+    toRgb(image.data + static_cast<size_t>(y) * image.stride, w, row_.data());
+    pump(applyFilter(options_.pngFilter, row_.data(), prev_.data(), n,
+                     filtered_),
+         n + 1, Z_NO_FLUSH);
+    row_.swap(prev_);
+  }
+  pump(nullptr, 0, Z_FINISH);
+  out_.resize(dataStart + zs.total_out);
+  closeChunk(out_, chunk);
+
+  chunk = openChunk(out_, "IEND");
+  closeChunk(out_, chunk);
+}
+
+// ---------------- QOI ----------------
+// https://qoiformat.org/qoi-specification.pdf, con 3 canales (alfa siempre
+// 255)
+void ImageWriter::encodeQoi(const ImageView &image) {
+  out_.reserve(14 + static_cast<size_t>(image.width) * image.height * 4 + 8);
+  out_.insert(out_.end(), {'q', 'o', 'i', 'f'});
+  putBE32(out_, image.width);
+  putBE32(out_, image.height);
+  out_.push_back(3); // RGB
+  out_.push_back(0); // sRGB con alfa lineal
+
+  struct Rgba {
+    unsigned char r, g, b, a;
+  };
+  Rgba index[64] = {};
+  Rgba prev{0, 0, 0, 255};
+  int run = 0;
+
+  for (int y = 0; y < image.height; ++y) {
+    const uint32_t *px = image.data + static_cast<size_t>(y) * image.stride;
+    for (int x = 0; x < image.width; ++x) {
+      const Rgba c{red(px[x]), green(px[x]), blue(px[x]), 255};
+      if (c.r == prev.r && c.g == prev.g && c.b == prev.b) {
+        if (++run == 62) {
+          out_.push_back(kQoiOpRun | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        out_.push_back(kQoiOpRun | (run - 1));
+        run = 0;
+      }
+
+      const int h = (c.r * 3 + c.g * 5 + c.b * 7 + c.a * 11) % 64;
+      const Rgba &slot = index[h];
+      if (slot.r == c.r && slot.g == c.g && slot.b == c.b && slot.a == c.a) {
+        out_.push_back(kQoiOpIndex | h);
+      } else {
+        index[h] = c;
+        const signed char dr = static_cast<signed char>(c.r - prev.r);
+        const signed char dg = static_cast<signed char>(c.g - prev.g);
+        const signed char db = static_cast<signed char>(c.b - prev.b);
+        const signed char drg = static_cast<signed char>(dr - dg);
+        const signed char dbg = static_cast<signed char>(db - dg);
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+          out_.push_back(kQoiOpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 &&
+                   dbg >= -8 && dbg <= 7) {
+          out_.push_back(kQoiOpLuma | (dg + 32));
+          out_.push_back((drg + 8) << 4 | (dbg + 8));
+        } else {
+          out_.insert(out_.end(), {kQoiOpRgb, c.r, c.g, c.b});
+        }
+      }
+      prev = c;
+    }
+  }
+  if (run > 0)
+    out_.push_back(kQoiOpRun | (run - 1));
+  out_.insert(out_.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+// ---------------- PPM ----------------
+void ImageWriter::encodePpm(const ImageView &image) {
+  char header[64];
+  const int len = std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n",
+                                image.width, image.height);
+  out_.insert(out_.end(), header, header + len);
+  size_t pos = out_.size();
+  out_.resize(pos + static_cast<size_t>(image.width) * image.height * 3);
+  for (int y = 0; y < image.height; ++y) {
+    const uint32_t *px = image.data + static_cast<size_t>(y) * image.stride;
+    for (int x = 0; x < image.width; ++x) {
+      out_[pos++] = red(px[x]);
+      out_[pos++] = green(px[x]);
+      out_[pos++] = blue(px[x]);
+    }
+  }
+}
+
+// ---------------- PNG por franjas ----------------
+void PngStrip::compress(const EncodeOptions &options, const ImageView &rows,
+                        const uint32_t *prev, bool last) {
+  const size_t w = static_cast<size_t>(rows.width);
+  const size_t n = 3 * w;
+  std::vector<unsigned char> row(n), before(n, 0);
+  std::vector<unsigned char> filtered[5];
+  for (auto &f : filtered)
+    f.resize(n + 1);
+  if (prev)
+    toRgb(prev, w, before.data());
+
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  // Deflate crudo (sin encabezado zlib): lo pone PngStripFile
+  if (deflateInit2(&zs, std::clamp(options.pngLevel, 0, 9), Z_DEFLATED, -15,
+                   8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::runtime_error("No se pudo inicializar zlib");
+  rawBytes = (n + 1) * rows.height;
+  bytes.resize(deflateBound(&zs, static_cast<uLong>(rawBytes)) + 16);
+  adler = 1;
+  auto pump = [&](const unsigned char *data, size_t len, int flush) {
+    zs.next_in = const_cast<unsigned char *>(data);
+    zs.avail_in = static_cast<uInt>(len);
+    for (;;) {
+      if (bytes.size() == zs.total_out)
+        bytes.resize(bytes.size() + bytes.size() / 2 + 1024);
+      zs.next_out = bytes.data() + zs.total_out;
+      zs.avail_out = static_cast<uInt>(bytes.size() - zs.total_out);
+      const int r = deflate(&zs, flush);
+      if (flush == Z_FINISH ? r == Z_STREAM_END
+                            : zs.avail_in == 0 && zs.avail_out > 0)
+        break;
+    }
+  };
+
+  for (int y = 0; y < rows.height; ++y) {
+    toRgb(rows.data + static_cast<size_t>(y) * rows.stride, w, row.data());
+    const unsigned char *f =
+        applyFilter(options.pngFilter, row.data(), before.data(), n, filtered);
+    adler = static_cast<uint32_t>(adler32(adler, f, static_cast<uInt>(n + 1)));
+    pump(f, n + 1, Z_NO_FLUSH);
+    row.swap(before);
+  }
+  // Las franjas intermedias terminan alineadas a byte (Z_SYNC_FLUSH) para
+  // poder concatenarse; la última cierra el stream
+  pump(nullptr, 0, last ? Z_FINISH : Z_SYNC_FLUSH);
+  bytes.resize(zs.total_out);
+  deflateEnd(&zs);
+}
+
+PngStripFile::PngStripFile(const EncodeOptions &options,
+                           const std::string &filename, int width, int height)
+    : filename_(filename), file_(std::fopen(filename.c_str(), "wb")) {
+  if (!file_) {
+    std::cerr << "Error al abrir " << filename << "\n";
+    return;
+  }
+  std::vector<unsigned char> header;
+  pngHeader(header, width, height);
+  if (std::fwrite(header.data(), 1, header.size(), file_) != header.size())
+    failed_ = true;
+
+  // Encabezado zlib (deflate, ventana de 32 KiB) con el nivel informativo
+  const int level = std::clamp(options.pngLevel, 0, 9);
+  const int flevel = level <= 1 ? 0 : level <= 5 ? 1 : level == 6 ? 2 : 3;
+  unsigned char zlibHeader[2] = {0x78, static_cast<unsigned char>(flevel << 6)};
+  zlibHeader[1] += (31 - (0x78 * 256 + zlibHeader[1]) % 31) % 31;
+  chunk("IDAT", zlibHeader, 2);
+}
+
+PngStripFile::~PngStripFile() {
+  if (file_)
+    std::fclose(file_);
+}
+
+bool PngStripFile::chunk(const char type[4], const unsigned char *data,
+                         size_t len) {
+  if (!file_ || failed_)
+    return false;
+  unsigned char head[8] = {static_cast<unsigned char>(len >> 24),
+                           static_cast<unsigned char>(len >> 16),
+                           static_cast<unsigned char>(len >> 8),
+                           static_cast<unsigned char>(len),
+                           static_cast<unsigned char>(type[0]),
+                           static_cast<unsigned char>(type[1]),
+                           static_cast<unsigned char>(type[2]),
+                           static_cast<unsigned char>(type[3])};
+  uLong crc = crc32(0, head + 4, 4);
+  if (len)
+    crc = crc32(crc, data, static_cast<uInt>(len));
+  const unsigned char tail[4] = {
+      static_cast<unsigned char>(crc >> 24), static_cast<unsigned char>(crc >> 16),
+      static_cast<unsigned char>(crc >> 8), static_cast<unsigned char>(crc)};
+  if (std::fwrite(head, 1, 8, file_) != 8 ||
+      (len && std::fwrite(data, 1, len, file_) != len) ||
+      std::fwrite(tail, 1, 4, file_) != 4) {
+    std::cerr << "Error al escribir " << filename_ << "\n";
+    failed_ = true;
+  }
+  return !failed_;
+}
+
+bool PngStripFile::append(const PngStrip &strip) {
+  adler_ = static_cast<uint32_t>(adler32_combine(
+      adler_, strip.adler, static_cast<z_off_t>(strip.rawBytes)));
+  return chunk("IDAT", strip.bytes.data(), strip.bytes.size());
+}
+
+bool PngStripFile::finish() {
+  const unsigned char trailer[4] = {
+      static_cast<unsigned char>(adler_ >> 24),
+      static_cast<unsigned char>(adler_ >> 16),
+      static_cast<unsigned char>(adler_ >> 8),
+      static_cast<unsigned char>(adler_)};
+  chunk("IDAT", trailer, 4);
+  chunk("IEND", nullptr, 0);
+  if (file_ && std::fclose(file_) != 0) {
+    std::cerr << "Error al escribir " << filename_ << "\n";
+    failed_ = true;
+  }
+  file_ = nullptr;
+  return !failed_;
+}
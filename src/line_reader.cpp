@@ -0,0 +1,235 @@
+#include "line_reader.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <zlib.h>
+
+#ifdef GRANULAR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// Tamaño de cada bloque descomprimido; el buffer crece sólo si una línea
+// no entra entera
+constexpr size_t kChunk = 1 << 18;
+
+// ---------------- Texto plano ----------------
+class PlainLineReader final : public LineReader {
+public:
+  explicit PlainLineReader(MappedFile file) : LineReader(std::move(file)) {
+    pending_ = source_.view();
+  }
+
+protected:
+  bool refill() override { return false; }
+};
+
+// ---------------- Base para formatos comprimidos ----------------
+class StreamLineReader : public LineReader {
+protected:
+  StreamLineReader(MappedFile file, std::pmr::memory_resource *mem)
+      : LineReader(std::move(file)), buffer_(mem) {}
+
+  // Descomprime hasta `cap` bytes en `dst`; devuelve los bytes escritos
+  // (0 = fin del flujo o error)
+  virtual size_t decompress(char *dst, size_t cap) = 0;
+
+  bool refill() override {
+    // Mover la línea incompleta al principio del buffer
+    const size_t carry = pending_.size();
+    if (carry && pending_.data() != buffer_.data())
+      std::memmove(buffer_.data(), pending_.data(), carry);
+    if (buffer_.size() < carry + kChunk)
+      buffer_.resize(carry + kChunk);
+
+    const size_t n = decompress(buffer_.data() + carry, buffer_.size() - carry);
+    pending_ = std::string_view(buffer_.data(), carry + n);
+    return n > 0;
+  }
+
+private:
+  std::pmr::vector<char> buffer_;
+};
+
+// ---------------- gzip / zlib ----------------
+// El estado interno de zlib (ventana de 32 KB) también sale del
+// memory_resource; zfree no recibe el tamaño, así que va en un encabezado
+constexpr size_t kZHeader = alignof(std::max_align_t);
+
+voidpf zAlloc(voidpf opaque, uInt items, uInt size) {
+  auto *mem = static_cast<std::pmr::memory_resource *>(opaque);
+  const size_t bytes = static_cast<size_t>(items) * size + kZHeader;
+  auto *p = static_cast<char *>(mem->allocate(bytes, kZHeader));
+  std::memcpy(p, &bytes, sizeof(bytes));
+  return p + kZHeader;
+}
+
+void zFree(voidpf opaque, voidpf ptr) {
+  auto *mem = static_cast<std::pmr::memory_resource *>(opaque);
+  char *p = static_cast<char *>(ptr) - kZHeader;
+  size_t bytes;
+  std::memcpy(&bytes, p, sizeof(bytes));
+  mem->deallocate(p, bytes, kZHeader);
+}
+
+class GzipLineReader final : public StreamLineReader {
+public:
+  GzipLineReader(MappedFile file, std::pmr::memory_resource *mem)
+      : StreamLineReader(std::move(file), mem) {
+    auto in = source_.view();
+    zs_.zalloc = zAlloc;
+    zs_.zfree = zFree;
+    zs_.opaque = mem;
+    zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs_.avail_in = static_cast<uInt>(in.size());
+    // 15 + 32: detecta automáticamente encabezado gzip o zlib
+    ok_ = inflateInit2(&zs_, 15 + 32) == Z_OK;
+  }
+  ~GzipLineReader() override {
+    if (ok_)
+      inflateEnd(&zs_);
+  }
+  bool ok() const { return ok_; }
+
+protected:
+  size_t decompress(char *dst, size_t cap) override {
+    if (!ok_ || done_)
+      return 0;
+    zs_.next_out = reinterpret_cast<Bytef *>(dst);
+    zs_.avail_out = static_cast<uInt>(cap);
+    while (zs_.avail_out > 0) {
+      int ret = inflate(&zs_, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        // Archivos con varios miembros gzip concatenados (p.ej. cat a.gz b.gz)
+        if (zs_.avail_in == 0) {
+          done_ = true;
+          break;
+        }
+        inflateReset(&zs_);
+      } else if (ret != Z_OK) {
+        if (ret != Z_BUF_ERROR || zs_.avail_in == 0)
+          std::cerr << "[WARN] gzip: flujo truncado o corrupto\n";
+        done_ = true;
+        break;
+      }
+    }
+    return cap - zs_.avail_out;
+  }
+
+private:
+  z_stream zs_{};
+  bool ok_ = false;
+  bool done_ = false;
+};
+
+#ifdef GRANULAR_HAVE_ZSTD
+// ---------------- zstd ----------------
+class ZstdLineReader final : public StreamLineReader {
+public:
+  ZstdLineReader(MappedFile file, std::pmr::memory_resource *mem)
+      : StreamLineReader(std::move(file), mem), ds_(ZSTD_createDStream()) {
+    auto in = source_.view();
+    in_ = {in.data(), in.size(), 0};
+    if (ds_)
+      ZSTD_initDStream(ds_);
+  }
+  ~ZstdLineReader() override { ZSTD_freeDStream(ds_); }
+  bool ok() const { return ds_ != nullptr; }
+
+protected:
+  size_t decompress(char *dst, size_t cap) override {
+    if (!ds_ || done_)
+      return 0;
+    ZSTD_outBuffer out = {dst, cap, 0};
+    while (out.pos < out.size) {
+      const size_t outBefore = out.pos, inBefore = in_.pos;
+      size_t ret = ZSTD_decompressStream(ds_, &out, &in_);
+      if (ZSTD_isError(ret)) {
+        std::cerr << "[WARN] zstd: " << ZSTD_getErrorName(ret) << "\n";
+        done_ = true;
+        break;
+      }
+      // Sin progreso: entrada agotada y decodificador vacío
+      if (out.pos == outBefore && in_.pos == inBefore) {
+        done_ = true;
+        break;
+      }
+    }
+    return out.pos;
+  }
+
+private:
+  ZSTD_DStream *ds_;
+  ZSTD_inBuffer in_{};
+  bool done_ = false;
+};
+#endif
+
+template <typename T, typename... Args>
+LineReader::Ptr makeReader(std::pmr::memory_resource *mem, Args &&...args) {
+  void *p = mem->allocate(sizeof(T), alignof(T));
+  auto *r = new (p) T(std::forward<Args>(args)...);
+  return LineReader::Ptr(r, {mem, sizeof(T), alignof(T)});
+}
+
+bool endsWith(std::string_view s, std::string_view suffix) {
+  return s.size() >= suffix.size() &&
+         s.substr(s.size() - suffix.size()) == suffix;
+}
+
+} // namespace
+
+// ---------------- LineReader::open ----------------
+LineReader::Ptr LineReader::open(const std::string &filename,
+                                 std::pmr::memory_resource *mem) {
+  return open(MappedFile(filename), filename, mem);
+}
+
+LineReader::Ptr LineReader::open(MappedFile file, const std::string &filename,
+                                 std::pmr::memory_resource *mem) {
+  if (!file.valid())
+    return nullptr;
+
+  const std::string_view comp = Compression::suffix(filename);
+  if (comp == ".gz") {
+    auto r = makeReader<GzipLineReader>(mem, std::move(file), mem);
+    if (!static_cast<GzipLineReader &>(*r).ok())
+      return nullptr;
+    return r;
+  }
+  if (comp == ".zst") {
+#ifdef GRANULAR_HAVE_ZSTD
+    auto r = makeReader<ZstdLineReader>(mem, std::move(file), mem);
+    if (!static_cast<ZstdLineReader &>(*r).ok())
+      return nullptr;
+    return r;
+#else
+    std::cerr << "[ERROR] " << filename
+              << ": compilado sin soporte zstd (falta libzstd)\n";
+    return nullptr;
+#endif
+  }
+  return makeReader<PlainLineReader>(mem, std::move(file));
+}
+
+// ---------------- Compression ----------------
+std::string_view Compression::suffix(std::string_view filename) {
+  for (std::string_view s : suffixes)
+    if (!s.empty() && endsWith(filename, s))
+      return s;
+  return {};
+}
+
+std::string Compression::findInput(const std::string &base,
+                                   const std::string &ext) {
+  for (const char *s : suffixes) {
+    std::string candidate = base + ext + s;
+    if (std::filesystem::exists(candidate))
+      return candidate;
+  }
+  return {};
+}
@@ -4,14 +4,19 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
-#include <future>
+#include <thread>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <map>
+#include <memory>
+#include <cmath>
 
-#include "thread_pool.hpp"   // tu implementación de ThreadPool (header-only preferible)
+#include "frame_pipeline.hpp"
+#include "run_manifest.hpp"
 #include "parser.hpp"
-#include "renderer.hpp"
+#include "frame_binary.hpp"
+#include "line_reader.hpp"
 #include "colormap.hpp"      // viridis(), inferno(), RdYlBu(), ...
 #include "histogram_magnitude_2d.hpp"                             //
 
@@ -77,6 +82,26 @@ int main(int argc, char* argv[]) {
     double ymax = 20.0;
     double valmin = 0.0;
     double valmax = 1.0;
+    PipelineConfig pipeline = PipelineConfig::defaults(std::thread::hardware_concurrency());
+    bool force = false;          // ignorar el manifest y re-renderizar todo
+    size_t checkpointEvery = 50; // frames entre checkpoints del manifest
+    std::string backendName = "cairo"; // rasterizador de los granos
+    bool batched = false;              // un relleno por color (backend cairo)
+    double lod = 0.0;                  // radio (px) bajo el cual un grano es una huella
+    std::string formatName = "png";    // png, qoi o ppm
+    std::string pngFilterName = "adaptive";
+    int pngLevel = 6;
+    StreamOptions stream;              // --stream: un único Y4M/RGB ordenado
+    std::string streamFormatName = "y4m";
+    PersistOptions persist;            // persistencia (tblend/tmix) en el render
+    std::string persistWeights;
+    int tile = 0;                      // > 0: render por tiles (imágenes enormes)
+    std::vector<std::pair<std::string, std::string>> outputSpecs; // nombre -> 'clave=valor ...'
+    int histBinsX = 0, histBinsY = 0;  // celdas del histograma (0: de 1x1)
+    double histCell = 0.0;             // > 0: lado de celda del histograma
+    bool histArea = false;             // histograma pesado por área
+    size_t histWindow = 0;             // > 0: histogramas por ventanas de frames
+    size_t histStride = 0;             // frames entre ventanas (0: histWindow)
 
     // Simple argv parsing
     for (int i = 1; i < argc; ++i) {
@@ -91,6 +116,32 @@ int main(int argc, char* argv[]) {
         else if ((a == "--margin") && i + 1 < argc) { margin = std::stod(argv[++i]); }
         else if ((a == "--valmin") && i + 1 < argc) { valmin = std::stod(argv[++i]); }
         else if ((a == "--valmax") && i + 1 < argc) { valmax = std::stod(argv[++i]); }
+        else if ((a == "--io-threads") && i + 1 < argc) { pipeline.ioThreads = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--parse-threads") && i + 1 < argc) { pipeline.parseThreads = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--render-threads") && i + 1 < argc) { pipeline.renderThreads = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--encode-threads") && i + 1 < argc) { pipeline.encodeThreads = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--queue-depth") && i + 1 < argc) { pipeline.queueDepth = std::max(1, std::stoi(argv[++i])); }
+        else if (a == "--force") { force = true; }
+        else if ((a == "--checkpoint-every") && i + 1 < argc) { checkpointEvery = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--backend") && i + 1 < argc) { backendName = argv[++i]; }
+        else if (a == "--batched") { batched = true; }
+        else if ((a == "--lod") && i + 1 < argc) { lod = std::max(0.0, std::stod(argv[++i])); }
+        else if ((a == "--format") && i + 1 < argc) { formatName = argv[++i]; }
+        else if ((a == "--png-level") && i + 1 < argc) { pngLevel = std::clamp(std::stoi(argv[++i]), 0, 9); }
+        else if ((a == "--png-filter") && i + 1 < argc) { pngFilterName = argv[++i]; }
+        else if ((a == "--stream") && i + 1 < argc) { stream.path = argv[++i]; }
+        else if ((a == "--stream-format") && i + 1 < argc) { streamFormatName = argv[++i]; }
+        else if ((a == "--fps") && i + 1 < argc) { stream.fps = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--persist-frames") && i + 1 < argc) { persist.frames = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--persist-weights") && i + 1 < argc) { persistWeights = argv[++i]; }
+        else if ((a == "--persist-opacity") && i + 1 < argc) { persist.opacity = std::clamp(std::stod(argv[++i]), 0.0, 1.0); }
+        else if ((a == "--tile") && i + 1 < argc) { tile = std::max(0, std::stoi(argv[++i])); }
+        else if ((a == "--output-spec") && i + 2 < argc) { outputSpecs.emplace_back(argv[i + 1], argv[i + 2]); i += 2; }
+        else if ((a == "--hist-bins") && i + 2 < argc) { histBinsX = std::max(1, std::stoi(argv[++i])); histBinsY = std::max(1, std::stoi(argv[++i])); }
+        else if ((a == "--hist-cell") && i + 1 < argc) { histCell = std::max(0.0, std::stod(argv[++i])); }
+        else if (a == "--hist-area") { histArea = true; }
+        else if ((a == "--hist-window") && i + 1 < argc) { histWindow = std::max(0, std::stoi(argv[++i])); }
+        else if ((a == "--hist-stride") && i + 1 < argc) { histStride = std::max(0, std::stoi(argv[++i])); }
         else if ((a == "--xylimits" || a == "-xyl") && (i + 4 < argc)) {
             xmin = std::stod(argv[++i]);
             xmax = std::stod(argv[++i]);
@@ -103,7 +154,18 @@ int main(int argc, char* argv[]) {
                       << "       [--config <file>]\n"
                       << "       [--out <out_dir>] [--width <px>] [--height <px>] [--margin <px>]\n"
                       << "       [--xylimits xmin xmax ymin ymax]\n"
-                      << "       [--valmin <valmin>] [--valmax valmax]\n\n";
+                      << "       [--valmin <valmin>] [--valmax valmax]\n"
+                      << "       [--io-threads N] [--parse-threads N] [--render-threads N] [--encode-threads N]\n"
+                      << "       [--queue-depth N] [--checkpoint-every N] [--force]\n"
+                      << "       [--backend <cairo|soft>] [--batched] [--lod <px>]\n"
+                      << "       [--format <png|qoi|ppm>] [--png-level 0-9]\n"
+                      << "       [--png-filter <none|sub|up|paeth|adaptive>]\n"
+                      << "       [--stream <file|->] [--stream-format <y4m|rgb>] [--fps N]\n"
+                      << "       [--persist-frames K] [--persist-weights 'w1 ... wK'] [--persist-opacity 0-1]\n"
+                      << "       [--tile <px>]\n"
+                      << "       [--output-spec <name> 'property=<name> cmap=<name> size=WxH xylimits=xmin,xmax,ymin,ymax vals=min,max']\n"
+                      << "       [--hist-bins NX NY | --hist-cell <size>] [--hist-area]\n"
+                      << "       [--hist-window N] [--hist-stride S]\n\n";
             std::cout << "Property:\n";
             std::cout << "      - pressure\n";
             std::cout << "      - kinetic_energy\n";
@@ -127,10 +189,112 @@ int main(int argc, char* argv[]) {
     if (cfg.count("y_max")) ymax = std::stod(cfg["y_max"]);
     if (cfg.count("val_min")) valmin = std::stod(cfg["val_min"]);
     if (cfg.count("val_max")) valmax = std::stod(cfg["val_max"]);
+    if (cfg.count("backend")) backendName = cfg["backend"];
+    if (cfg.count("batched")) batched = cfg["batched"] == "1" || cfg["batched"] == "true";
+    if (cfg.count("lod")) lod = std::max(0.0, std::stod(cfg["lod"]));
+    if (cfg.count("format")) formatName = cfg["format"];
+    if (cfg.count("png_level")) pngLevel = std::clamp(std::stoi(cfg["png_level"]), 0, 9);
+    if (cfg.count("png_filter")) pngFilterName = cfg["png_filter"];
+    if (cfg.count("stream")) stream.path = cfg["stream"];
+    if (cfg.count("stream_format")) streamFormatName = cfg["stream_format"];
+    if (cfg.count("fps")) stream.fps = std::max(1, std::stoi(cfg["fps"]));
+    if (cfg.count("persist_frames")) persist.frames = std::max(1, std::stoi(cfg["persist_frames"]));
+    if (cfg.count("persist_weights")) persistWeights = cfg["persist_weights"];
+    if (cfg.count("persist_opacity")) persist.opacity = std::clamp(std::stod(cfg["persist_opacity"]), 0.0, 1.0);
+    if (cfg.count("tile")) tile = std::max(0, std::stoi(cfg["tile"]));
+    if (cfg.count("hist_bins")) {
+        std::istringstream bins(cfg["hist_bins"]);
+        if (bins >> histBinsX >> histBinsY) { histBinsX = std::max(1, histBinsX); histBinsY = std::max(1, histBinsY); }
+        else { std::cerr << "[WARN] Invalid hist_bins '" << cfg["hist_bins"] << "' (expected 'NX NY')\n"; histBinsX = histBinsY = 0; }
+    }
+    if (cfg.count("hist_cell")) histCell = std::max(0.0, std::stod(cfg["hist_cell"]));
+    if (cfg.count("hist_area")) histArea = cfg["hist_area"] == "1" || cfg["hist_area"] == "true";
+    if (cfg.count("hist_window")) histWindow = std::max(0, std::stoi(cfg["hist_window"]));
+    if (cfg.count("hist_stride")) histStride = std::max(0, std::stoi(cfg["hist_stride"]));
+    // Salidas adicionales: "output.<nombre> = clave=valor ...", en orden de
+    // nombre y sin pisar las dadas por línea de comandos
+    std::map<std::string, std::string> cfgOutputs;
+    for (const auto& [key, val] : cfg)
+        if (key.rfind("output.", 0) == 0) cfgOutputs.emplace(key.substr(7), val);
+    for (const auto& [name, spec] : cfgOutputs) {
+        bool given = std::any_of(outputSpecs.begin(), outputSpecs.end(),
+                                 [&](const auto& o) { return o.first == name; });
+        if (!given) outputSpecs.emplace_back(name, spec);
+    }
+
+    // Con el flujo en stdout, los mensajes van a stderr para no mezclarse
+    // con los frames
+    if (stream.path == "-") std::cout.rdbuf(std::cerr.rdbuf());
+
+    RenderBackend backend = RenderBackend::Cairo;
+    if (backendName == "soft") backend = RenderBackend::Soft;
+    else if (backendName != "cairo") {
+        std::cerr << "[WARN] Backend '" << backendName << "' no reconocido. Usando cairo.\n";
+        backendName = "cairo";
+    }
+
+    EncodeOptions encode;
+    encode.pngLevel = pngLevel;
+    if (!EncodeOptions::parseFormat(formatName, encode.format)) {
+        std::cerr << "[WARN] Formato '" << formatName << "' no reconocido. Usando png.\n";
+    }
+    if (!EncodeOptions::parseFilter(pngFilterName, encode.pngFilter)) {
+        std::cerr << "[WARN] Filtro PNG '" << pngFilterName << "' no reconocido. Usando adaptive.\n";
+    }
+    if (!StreamOptions::parseFormat(streamFormatName, stream.format)) {
+        std::cerr << "[WARN] Formato de flujo '" << streamFormatName << "' no reconocido. Usando y4m.\n";
+    }
+    if (!persistWeights.empty() && !PersistOptions::parseWeights(persistWeights, persist.weights)) {
+        std::cerr << "[WARN] Pesos de persistencia '" << persistWeights << "' no válidos. Usando todos 1.\n";
+    }
+    // Por tiles, cada frame se escribe por franjas en un PNG, sin tener la
+    // imagen entera en memoria
+    if (tile > 0) {
+        if (encode.format != ImageFormat::Png) {
+            std::cerr << "[WARN] El render por tiles sólo escribe PNG.\n";
+            encode.format = ImageFormat::Png;
+        }
+        if (stream.enabled() || persist.enabled()) {
+            std::cerr << "[WARN] --stream y --persist-frames no se usan con --tile.\n";
+            stream = StreamOptions{};
+            persist = PersistOptions{};
+        }
+        tile = std::max(tile, 16);
+    }
+
+    // Salidas adicionales del mismo parseo: parten de los parámetros de la
+    // principal y cambian lo que indique su especificación
+    std::vector<OutputSpec> outputs;
+    for (const auto& [name, spec] : outputSpecs) {
+        OutputSpec o;
+        o.name = name;
+        o.property = property;
+        o.cmapName = cmapName;
+        o.width = width; o.height = height;
+        o.xmin = xmin; o.xmax = xmax;
+        o.ymin = ymin; o.ymax = ymax;
+        o.valmin = valmin; o.valmax = valmax;
+        std::string bad;
+        if (name.empty() || name.find('/') != std::string::npos || name == "." || name == "..") {
+            std::cerr << "[WARN] Nombre de salida '" << name << "' no válido (se omite).\n";
+            continue;
+        }
+        if (!o.parse(spec, bad)) {
+            std::cerr << "[WARN] Salida '" << name << "': no se entiende '" << bad << "' (se omite).\n";
+            continue;
+        }
+        o.cmap = chooseColormap(o.cmapName);
+        outputs.push_back(std::move(o));
+    }
+    if (!outputs.empty() && (stream.enabled() || persist.enabled() || tile > 0)) {
+        std::cerr << "[WARN] --output-spec no se usa con --stream, --persist-frames ni --tile.\n";
+        outputs.clear();
+    }
 
     // Make output dir if needed
     try {
         if (!fs::exists(outputDir)) fs::create_directories(outputDir);
+        for (const OutputSpec& o : outputs) fs::create_directories(fs::path(outputDir) / o.name);
     } catch (const std::exception& e) {
         std::cerr << "[ERROR] No se pudo crear output dir '" << outputDir << "': " << e.what() << "\n";
         return 1;
@@ -140,115 +304,196 @@ int main(int argc, char* argv[]) {
     std::cout << "Output dir: " << outputDir << "\n";
     std::cout << "Property  : " << property << "\n";
     std::cout << "Colormap  : " << cmapName << "\n";
-    std::cout << "Image     : " << width << "x" << height << " (margin " << margin << " px)\n";
+    std::cout << "Image     : " << width << "x" << height << " (margin " << margin << " px)";
+    if (tile > 0) std::cout << ", tiles de " << tile << " px";
+    std::cout << "\n";
     std::cout << "Límites xy: " << xmin << " " << xmax << " " << ymin << " " << ymax << " (s.u. - m)\n";
     std::cout << "Rango vals: " << valmin << " " << valmax << "\n";
+    if (stream.enabled()) {
+        std::cout << "Flujo     : " << (stream.path == "-" ? "stdout" : stream.path) << " ("
+                  << StreamOptions::formatName(stream.format) << ", " << stream.fps << " fps)\n";
+    } else {
+        std::cout << "Formato   : " << EncodeOptions::formatName(encode.format);
+        if (encode.format == ImageFormat::Png)
+            std::cout << " (zlib " << encode.pngLevel << ", filtro " << EncodeOptions::filterName(encode.pngFilter) << ")";
+        std::cout << "\n";
+    }
+    std::cout << "Backend   : " << backendName << (batched && backendName == "cairo" ? " (batched)" : "");
+    if (lod > 0.0) std::cout << ", LOD bajo " << lod << " px";
+    std::cout << "\n";
+    for (const OutputSpec& o : outputs) {
+        std::cout << "Salida    : " << o.name << " (" << o.property << ", " << o.cmapName << ", "
+                  << o.width << "x" << o.height << ", límites " << o.xmin << " " << o.xmax << " "
+                  << o.ymin << " " << o.ymax << ", rango " << o.valmin << " " << o.valmax << ")\n";
+    }
+    if (persist.enabled()) {
+        std::cout << "Persist.  : " << persist.frames << " frames, opacidad " << persist.opacity << ", pesos";
+        if (persist.weights.empty()) std::cout << " 1";
+        for (double w : persist.weights) std::cout << " " << w;
+        std::cout << "\n";
+    }
 
     // choose colormap
     Colormap cmap = chooseColormap(cmapName);
 
-    // Cramos el histograma 2d 
-    // const int HISTOGRAM_BINS_X = 36;
-    // const int HISTOGRAM_BINS_Y = 105;
-    // MagnitudeHistogram globalHistogram(HISTOGRAM_BINS_X, HISTOGRAM_BINS_Y, 
-    //                                 xmin, xmax, ymin, ymax);
-    MagnitudeHistogram globalHistogram(xmin, xmax, ymin, ymax);
-
-    // thread pool (num threads = hardware concurrency or 4)
-    size_t nthreads = std::thread::hardware_concurrency();
-    if (nthreads == 0) nthreads = 4;
-    ThreadPool pool(nthreads);
-
-    std::vector<std::future<void>> futures;
+    // Cramos el histograma 2d: celdas de 1x1 salvo --hist-bins, o --hist-cell
+    // (redondeado a un número entero de celdas en el rango)
+    if (histCell > 0.0 && histBinsX == 0) {
+        histBinsX = std::max(1, static_cast<int>(std::lround((xmax - xmin) / histCell)));
+        histBinsY = std::max(1, static_cast<int>(std::lround((ymax - ymin) / histCell)));
+    }
+    std::unique_ptr<MagnitudeHistogram> histogram = histBinsX > 0
+        ? std::make_unique<MagnitudeHistogram>(histBinsX, histBinsY, xmin, xmax, ymin, ymax)
+        : std::make_unique<MagnitudeHistogram>(xmin, xmax, ymin, ymax);
+    histogram->setAreaWeighted(histArea);
+    MagnitudeHistogram& globalHistogram = *histogram;
+    std::cout << "Histograma: " << globalHistogram.getBinsX() << "x" << globalHistogram.getBinsY()
+              << " celdas de " << globalHistogram.getCellWidth() << "x" << globalHistogram.getCellHeight()
+              << (histArea ? ", pesado por área" : "") << "\n";
 
-    // iterate directory and enqueue tasks for each .xy
+    // iterate directory and collect one job per frame (.xy[.gz|.zst] or .gfb)
+    std::map<std::string, std::string> frames; // base (sin extensión) -> stem
     for (const auto& entry : fs::directory_iterator(inputDir)) {
         if (!entry.is_regular_file()) continue;
         auto path = entry.path();
-        if (path.extension() != ".xy") continue;
-
-        std::string xyFile = path.string();
-        std::string base = xyFile.substr(0, xyFile.size() - 3); // remove .xy
-        std::string sxyFile = base + ".sxy";
-        if (property=="kinetic_energy" || property=="velocity_norm")
-            sxyFile = base + ".ve";
-        std::string filenameOnly = path.filename().string();
-        std::string outFile = fs::path(outputDir) / (path.stem().string() + ".png");
-
-        // enqueue job
-        futures.push_back(pool.enqueue([xyFile, sxyFile, outFile, property, width, height, margin, cmap,
-                                        xmin, xmax, ymin, ymax, valmin, valmax, &globalHistogram]() mutable {
-            try {
-                // Check sxy exists
-                if (!fs::exists(sxyFile)) {
-                    std::cerr << "[WARN] Missing paired file: " << sxyFile << " (skipping " << xyFile << ")\n";
-                    return;
-                }
-
-                // Read sxy raw data (gid -> vector<double>)
-                auto sxyData = Parser::readSXY(sxyFile);
-
-                // Build grains from xy and associated scalars
-                auto grains = Parser::readXY(xyFile, sxyData, property);
-
-                if (grains.empty()) {
-                    std::cerr << "[WARN] No grains parsed from " << xyFile << "\n";
-                    return;
-                }
-                // Recolectar datos para el histograma global
-                std::vector<std::tuple<double, double, double>> frameData;
-                for (const auto &gptr : grains) {
-                    double x, y;
-                    
-                    if (auto circle = dynamic_cast<const CircleGrain*>(gptr.get())) {
-                        x = (circle->xmin() + circle->xmax()) / 2.0;
-                        y = (circle->ymin() + circle->ymax()) / 2.0;
-                    } else if (auto poly = dynamic_cast<const PolygonGrain*>(gptr.get())) {
-                        x = (poly->xmin() + poly->xmax()) / 2.0;
-                        y = (poly->ymin() + poly->ymax()) / 2.0;
-                    } else {
-                        continue;
-                    }
-                    
-                    frameData.emplace_back(x, y, gptr->scalar());
-                }
-            
-                // Agregar datos al histograma global (thread-safe)
-                globalHistogram.addPoints(frameData);
-
-                // Determine vmin/vmax from grains' scalars
-                double vmin =  1e300;
-                double vmax = -1e300;
-                for (const auto &gptr : grains) {
-                    double v = gptr->scalar();
-                    if (v < vmin) vmin = v;
-                    if (v > vmax) vmax = v;
-                }
-                if (vmin == 1e300 || vmax == -1e300) {
-                    vmin = 0.0; vmax = 1.0;
-                }
-                if (vmin == vmax) { // avoid degenerate range
-                    double eps = std::abs(vmin) * 1e-6 + 1e-6;
-                    vmin -= eps; vmax += eps;
-                }
-
-                // Create renderer and render
-                Renderer renderer(width, height, margin, valmin, valmax);
-                renderer.renderToPNG(outFile, grains, vmin, vmax, xmin, xmax, ymin, ymax, cmap);
-
-                std::cout << "[OK] " << outFile << "\n";
-            } catch (const std::exception &e) {
-                std::cerr << "[ERROR] processing " << xyFile << ": " << e.what() << "\n";
-            }
-        }));
+        std::string name = path.filename().string();
+        auto comp = Compression::suffix(name);
+        fs::path plain = name.substr(0, name.size() - comp.size());
+        bool isText = plain.extension() == ".xy";
+        bool isBinary = plain.extension() == FrameBinary::extension && comp.empty();
+        if (!isText && !isBinary) continue;
+        frames.emplace((path.parent_path() / plain.stem()).string(), plain.stem().string());
+    }
+
+    std::vector<FrameJob> jobs;
+    jobs.reserve(frames.size());
+    for (const auto& [base, stem] : frames) {
+        std::string xyFile = Compression::findInput(base, ".xy");
+        std::string gfbFile = base + FrameBinary::extension;
+        auto valuesFor = [&](const std::string& ext) {
+            std::string file = Compression::findInput(base, ext);
+            return file.empty() ? base + ext : file;
+        };
+        std::string sxyFile = valuesFor(Parser::valuesExtension(property));
+        // El otro archivo de valores, si alguna salida adicional lo usa
+        std::string otherExt = Parser::valuesExtension(property) == ".sxy" ? ".ve" : ".sxy";
+        std::string otherFile;
+        for (const OutputSpec& o : outputs) {
+            if (Parser::valuesExtension(o.property) == otherExt) otherFile = valuesFor(otherExt);
+        }
+
+        // Preferir el binario si existe y no es más viejo que ninguna de sus
+        // fuentes (.xy, .sxy y .ve, como en granular_frame_convert)
+        bool useBinary = fs::exists(gfbFile);
+        if (useBinary) {
+            auto t = fs::last_write_time(gfbFile);
+            if (!xyFile.empty() && fs::last_write_time(xyFile) > t) useBinary = false;
+            for (const auto& f : {sxyFile, valuesFor(otherExt)})
+                if (fs::exists(f) && fs::last_write_time(f) > t) useBinary = false;
+        }
+
+        FrameJob job;
+        job.index = jobs.size();
+        job.frameFile = useBinary ? gfbFile : xyFile;
+        job.valuesFile = sxyFile;
+        job.outFile = fs::path(outputDir) / (stem + encode.extension());
+        for (const OutputSpec& o : outputs)
+            job.outputFiles.push_back(fs::path(outputDir) / o.name / (stem + encode.extension()));
+        job.binary = useBinary;
+        // Con .gfb los valores van en el binario, pero los dos archivos de
+        // valores siguen entrando en la huella
+        job.otherValuesFile = useBinary ? valuesFor(otherExt) : otherFile;
+        job.fingerprint = RunManifest::fingerprint(job);
+        jobs.push_back(std::move(job));
     }
 
-    // wait for tasks
-    for (auto &f : futures) {
-        try { f.get(); } catch (const std::exception &e) {
-            std::cerr << "[ERROR] task exception: " << e.what() << "\n";
+    RenderSettings settings;
+    settings.property = property;
+    settings.width = width;
+    settings.height = height;
+    settings.margin = margin;
+    settings.xmin = xmin; settings.xmax = xmax;
+    settings.ymin = ymin; settings.ymax = ymax;
+    settings.valmin = valmin; settings.valmax = valmax;
+    settings.cmapName = cmapName;
+    settings.cmap = cmap;
+    settings.backend = backend;
+    settings.batched = batched && backend == RenderBackend::Cairo;
+    settings.lod = lod;
+    settings.encode = encode;
+    settings.stream = stream;
+    settings.persist = persist;
+    settings.tile = tile;
+    settings.outputs = outputs;
+
+    // Manifest de la corrida anterior: omitir frames al día y retomar el
+    // histograma desde su checkpoint
+    RunManifest manifest(outputDir, RunManifest::hashParams(settings.signature()),
+                         globalHistogram, checkpointEvery);
+    if (!force) manifest.load();
+    std::vector<bool> recorded(jobs.size());
+    for (size_t k = 0; k < jobs.size(); ++k) recorded[k] = manifest.isRecorded(jobs[k]);
+    // Las ventanas de tiempo necesitan los puntos de todos los frames: los al
+    // día se vuelven a leer sólo para el histograma
+    bool histogramRestored = false;
+    if (histWindow > 0) manifest.reset();
+    else histogramRestored = manifest.restoreHistogram(jobs);
+
+    // El flujo necesita todos los frames, aunque estén al día
+    std::vector<bool> render(jobs.size());
+    auto written = [](const FrameJob& job) {
+        return fs::exists(job.outFile) &&
+               std::all_of(job.outputFiles.begin(), job.outputFiles.end(),
+                           [](const std::string& f) { return fs::exists(f); });
+    };
+    for (size_t k = 0; k < jobs.size(); ++k)
+        render[k] = stream.enabled() || !(recorded[k] && written(jobs[k]));
+    // La persistencia mezcla cada frame con los persist.frames - 1 anteriores:
+    // también hay que renderizar esos, aunque estén al día, pero sin volver a
+    // escribirlos (su propia mezcla necesitaría frames aún más viejos)
+    std::vector<bool> write = render;
+    if (persist.enabled()) {
+        const size_t before = static_cast<size_t>(persist.frames) - 1;
+        for (size_t k = 0; k < jobs.size(); ++k) {
+            if (!write[k]) continue;
+            for (size_t j = k > before ? k - before : 0; j < k; ++j) render[j] = true;
         }
     }
+
+    std::vector<FrameJob> pending;
+    size_t skipped = 0, histogramOnly = 0;
+    for (size_t k = 0; k < jobs.size(); ++k) {
+        FrameJob job = jobs[k];
+        job.render = render[k];
+        job.write = write[k];
+        job.histogram = !(recorded[k] && histogramRestored);
+        if (!job.render && !job.histogram) { ++skipped; continue; }
+        if (!job.render) ++histogramOnly;
+        job.index = pending.size();
+        pending.push_back(std::move(job));
+    }
+    std::cout << "Frames    : " << jobs.size() << " (" << skipped << " up to date, "
+              << histogramOnly << " histogram only, "
+              << pending.size() - histogramOnly << " to render)\n";
+
+    std::cout << "Pipeline  : io " << pipeline.ioThreads << ", parse " << pipeline.parseThreads
+              << ", render " << pipeline.renderThreads << ", encode " << pipeline.encodeThreads << " threads\n";
+
+    // Con ventanas todos los frames están en `pending`, en orden
+    std::unique_ptr<HistogramSeries> series;
+    if (histWindow > 0) {
+        series = std::make_unique<HistogramSeries>(globalHistogram, pending.size(), histWindow,
+                                                   histStride > 0 ? histStride : histWindow,
+                                                   (fs::path(outputDir) / "histogram_series").string());
+        std::cout << "Ventanas  : " << series->windows() << " de " << histWindow << " frames cada "
+                  << (histStride > 0 ? std::min(histStride, histWindow) : histWindow) << " -> " << series->dir() << "\n";
+    }
+
+    FramePipeline framePipeline(settings, pipeline, globalHistogram, &manifest, series.get());
+    framePipeline.run(pending);
+    manifest.checkpoint();
+    if (series) series->finish();
+
     // Calcular promedios y guardar histograma global
     globalHistogram.computeAverages();
 
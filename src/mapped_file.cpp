@@ -0,0 +1,76 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::MappedFile(const std::string &filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return;
+  }
+
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ > 0) {
+    void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      return;
+    }
+    // Lectura secuencial: el kernel puede adelantar páginas agresivamente
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = p;
+  }
+  ::close(fd); // el mapeo sobrevive al descriptor
+  valid_ = true;
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      valid_(std::exchange(other.valid_, false)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    valid_ = std::exchange(other.valid_, false);
+  }
+  return *this;
+}
+
+void MappedFile::willNeed() const {
+  if (data_)
+    ::madvise(data_, size_, MADV_WILLNEED);
+}
+
+void MappedFile::prefault() const {
+  if (!data_)
+    return;
+  willNeed();
+  const long page = ::sysconf(_SC_PAGESIZE);
+  const volatile char *p = static_cast<const volatile char *>(data_);
+  char sink = 0;
+  for (std::size_t off = 0; off < size_; off += page)
+    sink ^= p[off];
+  (void)sink;
+}
+
+void MappedFile::release() {
+  if (data_)
+    ::munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+  valid_ = false;
+}
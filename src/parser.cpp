@@ -1,38 +1,160 @@
 #include "parser.hpp"
+#include "line_reader.hpp"
+#include <charconv>
 #include <cmath>
-#include <fstream>
 #include <iostream>
-#include <sstream>
+#include <string_view>
+
+// ---------------- Tokenizador ----------------
+// Las líneas llegan de un LineReader (mmap o descompresión por bloques) y se
+// recorren in situ: ni std::string ni std::istringstream por línea, y
+// std::from_chars no depende del locale.
+namespace {
+
+// Cursor sobre los campos de una línea separados por espacios
+class Tokens {
+public:
+  explicit Tokens(std::string_view line)
+      : p_(line.data()), end_(line.data() + line.size()) {}
+
+  // Lee un número; si el campo no es numérico deja `out` sin tocar
+  template <typename T> bool next(T &out) {
+    skipSpaces();
+    if (p_ < end_ && *p_ == '+')
+      ++p_;
+    auto [ptr, ec] = std::from_chars(p_, end_, out);
+    if (ec != std::errc())
+      return false;
+    p_ = ptr;
+    return true;
+  }
+
+  // Lee una palabra cualquiera (p.ej. "BOX")
+  std::string_view word() {
+    skipSpaces();
+    const char *start = p_;
+    while (p_ < end_ && !isSpace(*p_))
+      ++p_;
+    return {start, static_cast<size_t>(p_ - start)};
+  }
+
+private:
+  static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
+  void skipSpaces() {
+    while (p_ < end_ && isSpace(*p_))
+      ++p_;
+  }
+
+  const char *p_;
+  const char *end_;
+};
+
+bool isDataLine(std::string_view line) {
+  return !line.empty() && line[0] != '#' && line[0] != '\r';
+}
+
+// Recorre un archivo de valores fila a fila, en orden creciente de gid
+class ValueStream {
+public:
+  ValueStream(LineReader &reader, std::pmr::memory_resource *mem)
+      : reader_(reader), vals_(mem) {}
+
+  // Avanza hasta la fila de `gid`. Devuelve false si el archivo no la tiene
+  // (la fila siguiente queda pendiente para un gid mayor).
+  bool seek(int gid, std::span<const double> &row) {
+    if (!primed_) {
+      advance();
+      primed_ = true;
+    }
+    while (hasRow_ && rowGid_ < gid && !outOfOrder_)
+      advance();
+    if (hasRow_ && rowGid_ == gid) {
+      row = vals_;
+      return true;
+    }
+    return false;
+  }
+
+  // true si aparecieron ids repetidos o decrecientes
+  bool outOfOrder() const { return outOfOrder_; }
+
+  // Recorre las filas restantes: el orden sólo queda verificado (y las
+  // filas "faltantes" confirmadas) cuando se leyó el archivo entero
+  bool drainOrdered() {
+    while (hasRow_ && !outOfOrder_)
+      advance();
+    return !outOfOrder_;
+  }
+
+private:
+  void advance() {
+    std::string_view line;
+    while (reader_.next(line)) {
+      if (!isDataLine(line))
+        continue;
+      Tokens tok(line);
+      int gid;
+      if (!tok.next(gid))
+        continue;
+      if (hasRow_ && gid <= rowGid_)
+        outOfOrder_ = true;
+      vals_.clear();
+      double tmp;
+      while (tok.next(tmp))
+        vals_.push_back(tmp);
+      rowGid_ = gid;
+      hasRow_ = true;
+      return;
+    }
+    hasRow_ = false;
+  }
+
+  LineReader &reader_;
+  std::pmr::vector<double> vals_; // fila actual, reutilizada
+  int rowGid_ = 0;
+  bool hasRow_ = false;
+  bool primed_ = false;
+  bool outOfOrder_ = false;
+};
+
+} // namespace
 
 // ---------------- readSXY ----------------
-std::unordered_map<int, std::vector<double>>
-Parser::readSXY(const std::string &filename) {
-  std::unordered_map<int, std::vector<double>> data;
-  std::ifstream fin(filename);
-  if (!fin) {
+ValueTable Parser::readSXY(const std::string &filename) {
+  ValueTable data;
+  auto file = LineReader::open(filename);
+  if (!file) {
     std::cerr << "Error al abrir " << filename << "\n";
     return data;
   }
+  readSXY(*file, data);
+  return data;
+}
 
-  std::string line;
-  while (std::getline(fin, line)) {
-    if (line.empty() || line[0] == '#')
+void Parser::readSXY(LineReader &file, ValueTable &data) {
+  // Fila de trabajo reutilizada: la tabla copia los valores a su buffer denso
+  std::vector<double> vals;
+  std::string_view line;
+  while (file.next(line)) {
+    if (!isDataLine(line))
       continue;
-    std::istringstream iss(line);
+    Tokens tok(line);
     int gid;
-    iss >> gid;
-    std::vector<double> vals;
+    if (!tok.next(gid))
+      continue;
+    vals.clear();
     double tmp;
-    while (iss >> tmp)
+    while (tok.next(tmp))
       vals.push_back(tmp);
-    data[gid] = vals;
+    data.set(gid, vals);
   }
-  return data;
 }
 
 // ---------------- computeProperty ----------------
 double Parser::computeProperty(const std::string &property,
-                               const std::vector<double> &values) {
+                               std::span<const double> values) {
   if (property == "pressure") {
     // stress tensor σ_xx, σ_yy, σ_xy
     if (values.size() >= 3) {
@@ -47,7 +169,7 @@ double Parser::computeProperty(const std::string &property,
              0.000245; // TODO  Conversión a unidades exp. (m v^2)
     }
   } else if (property == "velocity_norm") {
-    if (values.size() >= 2) {
+    if (values.size() >= 5) {
       double vx = values[3], vy = values[4];
       return -vy * 0.2213594;
       // return std::sqrt(vx * vx + vy * vy) *
@@ -58,66 +180,253 @@ double Parser::computeProperty(const std::string &property,
   return values.empty() ? 0.0 : values[0];
 }
 
+// ---------------- computeColumns ----------------
+void Parser::computeColumns(const GrainStore &grains, const ValueTable &values,
+                            std::span<const std::string> properties,
+                            std::span<ScalarColumns *const> out) {
+  auto column = [&](const auto &gids, auto member) {
+    for (ScalarColumns *o : out)
+      (o->*member).resize(gids.size());
+    for (size_t i = 0; i < gids.size(); ++i) {
+      // Un grano sin fila (vacía si falta) queda en 0
+      const std::span<const double> row = values.find(gids[i]);
+      for (size_t k = 0; k < out.size(); ++k)
+        (out[k]->*member)[i] =
+            row.empty() ? 0.0 : computeProperty(properties[k], row);
+    }
+  };
+  column(grains.circles.gid, &ScalarColumns::circles);
+  column(grains.polygons.gid, &ScalarColumns::polygons);
+}
+
+// ---------------- valuesExtension ----------------
+std::string Parser::valuesExtension(const std::string &property) {
+  if (property == "kinetic_energy" || property == "velocity_norm")
+    return ".ve";
+  return ".sxy";
+}
+
 // ---------------- readXY ----------------
-std::vector<std::unique_ptr<Grain>>
-Parser::readXY(const std::string &filename,
-               const std::unordered_map<int, std::vector<double>> &scalarData,
-               const std::string &property) {
-  std::vector<std::unique_ptr<Grain>> grains;
-  std::ifstream fin(filename);
-  if (!fin) {
+namespace {
+
+// Pared del contenedor: vértices seguidos de la palabra BOX
+void readWall(Tokens &tok, int gid, int nvert, GrainStore &grains) {
+  for (int i = 0; i < nvert; i++) {
+    double vx = 0.0, vy = 0.0;
+    tok.next(vx);
+    tok.next(vy);
+    grains.walls.addVertex(vx, vy);
+  }
+  tok.word();
+  grains.walls.close(gid, 0, -1.0);
+}
+
+// Resto de la línea de un grano: círculo (x y r tipo) o polígono (vértices
+// y tipo)
+void readGrain(Tokens &tok, int gid, int nvert, double scalar,
+               GrainStore &grains) {
+  int type = 0;
+  if (nvert == 1) {
+    double x = 0.0, y = 0.0, r = 0.0;
+    tok.next(x);
+    tok.next(y);
+    tok.next(r);
+    tok.next(type);
+    grains.circles.add(gid, type, x, y, r, scalar);
+  } else {
+    for (int i = 0; i < nvert; i++) {
+      double vx = 0.0, vy = 0.0;
+      tok.next(vx);
+      tok.next(vy);
+      grains.polygons.addVertex(vx, vy);
+    }
+    tok.next(type);
+    grains.polygons.close(gid, type, scalar);
+  }
+}
+
+} // namespace
+
+GrainStore Parser::readXY(const std::string &filename,
+                          const ValueTable &scalarData,
+                          const std::string &property) {
+  GrainStore grains;
+  readXY(filename, scalarData, property, grains);
+  return grains;
+}
+
+bool Parser::readXY(const std::string &filename, const ValueTable &scalarData,
+                    const std::string &property, GrainStore &grains) {
+  auto file = LineReader::open(filename, grains.resource());
+  if (!file) {
     std::cerr << "Error al abrir " << filename << "\n";
-    return grains;
+    return false;
   }
+  readXY(*file, scalarData, property, grains);
+  return true;
+}
 
-  std::string line;
-  while (std::getline(fin, line)) {
-    if (line.empty() || line[0] == '#')
+void Parser::readXY(LineReader &file, const ValueTable &scalarData,
+                    const std::string &property, GrainStore &grains) {
+  std::string_view line;
+  while (file.next(line)) {
+    if (!isDataLine(line))
       continue;
-    std::istringstream iss(line);
+    Tokens tok(line);
     double scalar = 0.0;
 
-    int gid, nvert, type;
-    iss >> gid >> nvert;
+    int gid, nvert;
+    if (!tok.next(gid) || !tok.next(nvert))
+      continue;
 
     if (gid < 0) {
-      // Polígono especial BOX, lo ignoramos por ahora
-      std::vector<std::pair<double, double>> vertices;
-      for (int i = 0; i < nvert; i++) {
-        double vx, vy;
-        iss >> vx >> vy;
-        vertices.emplace_back(vx, vy);
-      }
-      std::string word;
-      iss >> word;
-      scalar = -1.0;
-      grains.push_back(
-          std::make_unique<BorderGrain>(gid, type, vertices, scalar));
+      readWall(tok, gid, nvert, grains);
+      continue;
     }
 
-    auto it = scalarData.find(gid);
-    if (it != scalarData.end()) {
-      scalar = computeProperty(property, it->second);
+    if (scalarData.contains(gid)) {
+      scalar = computeProperty(property, scalarData.find(gid));
     }
+    readGrain(tok, gid, nvert, scalar, grains);
+  }
+}
+
+// ---------------- readFrame ----------------
+GrainStore Parser::readFrame(const std::string &xyFile,
+                             const std::string &valuesFile,
+                             const std::string &property) {
+  auto xy = LineReader::open(xyFile);
+  auto values = LineReader::open(valuesFile);
+  if (!xy || !values) {
+    std::cerr << "Error al abrir " << (xy ? valuesFile : xyFile) << "\n";
+    return GrainStore{};
+  }
+  // Ambos archivos se leen a la par: el kernel adelanta los dos mientras
+  // se tokeniza
+  xy->willNeed();
+  values->willNeed();
+  return readFrame(*xy, *values, xyFile, valuesFile, property);
+}
+
+GrainStore Parser::readFrame(LineReader &xy, LineReader &values,
+                             const std::string &xyFile,
+                             const std::string &valuesFile,
+                             const std::string &property) {
+  GrainStore grains;
+  readFrame(xy, values, xyFile, valuesFile, property, grains);
+  return grains;
+}
 
-    if (nvert == 1) {
-      // círculo
-      double x, y, r;
-      iss >> x >> y >> r >> type;
-      grains.push_back(
-          std::make_unique<CircleGrain>(gid, type, x, y, r, scalar));
+bool Parser::readFrame(LineReader &xy, LineReader &values,
+                       const std::string &xyFile, const std::string &valuesFile,
+                       const std::string &property, GrainStore &grains) {
+  // Respaldo por tabla cuando el orden no se cumple: se descarta lo parseado
+  auto fallback = [&] {
+    grains.clear();
+    return readXY(xyFile, readSXY(valuesFile), property, grains);
+  };
+  ValueStream stream(values, grains.resource());
+  std::string_view line;
+  int lastGid = -1;
+  while (xy.next(line)) {
+    if (!isDataLine(line))
+      continue;
+    Tokens tok(line);
+    int gid, nvert;
+    if (!tok.next(gid) || !tok.next(nvert))
+      continue;
+
+    if (gid < 0) {
+      readWall(tok, gid, nvert, grains);
+      continue;
+    }
+
+    // Orden roto en cualquiera de los dos archivos: se usa la tabla
+    std::span<const double> row;
+    bool found = gid > lastGid && stream.seek(gid, row);
+    if (gid <= lastGid || stream.outOfOrder())
+      return fallback();
+    lastGid = gid;
+    double scalar = found ? computeProperty(property, row) : 0.0;
+    readGrain(tok, gid, nvert, scalar, grains);
+  }
+  if (!stream.drainOrdered())
+    return fallback();
+  return true;
+}
+
+// ---------------- readValueColumns ----------------
+bool Parser::readValueColumns(const std::string &filename, ValueColumns &cols) {
+  cols = ValueColumns{};
+  auto file = LineReader::open(filename);
+  if (!file) {
+    std::cerr << "Error al abrir " << filename << "\n";
+    return false;
+  }
+
+  cols.offset.push_back(0);
+  std::string_view line;
+  while (file->next(line)) {
+    if (!isDataLine(line))
+      continue;
+    Tokens tok(line);
+    int gid;
+    if (!tok.next(gid))
+      continue;
+    double tmp;
+    while (tok.next(tmp))
+      cols.values.push_back(tmp);
+    cols.gid.push_back(gid);
+    cols.offset.push_back(static_cast<uint32_t>(cols.values.size()));
+  }
+  return true;
+}
+
+// ---------------- readXYColumns ----------------
+bool Parser::readXYColumns(const std::string &filename, FrameColumns &cols) {
+  cols = FrameColumns{};
+  auto file = LineReader::open(filename);
+  if (!file) {
+    std::cerr << "Error al abrir " << filename << "\n";
+    return false;
+  }
+
+  cols.vtxOffset.assign(1, 0);
+  std::string_view line;
+  while (file->next(line)) {
+    if (!isDataLine(line))
+      continue;
+    Tokens tok(line);
+    int gid, nvert, type = 0;
+    if (!tok.next(gid) || !tok.next(nvert))
+      continue;
+
+    double x = 0.0, y = 0.0, r = 0.0;
+    if (gid >= 0 && nvert == 1) {
+      tok.next(x);
+      tok.next(y);
+      tok.next(r);
+      tok.next(type);
     } else {
-      // polígono
-      std::vector<std::pair<double, double>> vertices;
       for (int i = 0; i < nvert; i++) {
-        double vx, vy;
-        iss >> vx >> vy;
-        vertices.emplace_back(vx, vy);
+        double vx = 0.0, vy = 0.0;
+        tok.next(vx);
+        tok.next(vy);
+        cols.vx.push_back(vx);
+        cols.vy.push_back(vy);
       }
-      iss >> type;
-      grains.push_back(
-          std::make_unique<PolygonGrain>(gid, type, vertices, scalar));
+      if (gid < 0)
+        tok.word(); // BOX
+      else
+        tok.next(type);
     }
+    cols.gid.push_back(gid);
+    cols.type.push_back(type);
+    cols.nv.push_back(nvert);
+    cols.vtxOffset.push_back(static_cast<uint32_t>(cols.vx.size()));
+    cols.cx.push_back(x);
+    cols.cy.push_back(y);
+    cols.radius.push_back(r);
   }
-  return grains;
+  return true;
 }
@@ -1,86 +1,721 @@
+#include <algorithm>
 #include <cairo/cairo.h>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <numbers>
+#include <numeric>
 #include <string>
 
 #include "colormap.hpp"
 #include "renderer.hpp"
+#include "soft_raster.hpp"
+#include "thread_pool.hpp"
+
+// ---------------- Bucles por tipo de grano ----------------
+// Cada tipo se recorre sobre sus propias columnas: sin despacho virtual ni
+// std::function por vértice, y `color` se resuelve en tiempo de compilación
+namespace {
+
+template <typename ColorFn, typename Keep>
+void fillCircles(cairo_t *cr, const CircleColumns &c, const ScreenTransform &t,
+                 ColorFn &&color, Keep &&keep) {
+  const size_t n = c.size();
+  for (size_t i = 0; i < n; ++i) {
+    if (!keep(i))
+      continue;
+    std::array<double, 3> col = color(c.scalar[i]);
+    cairo_set_source_rgb(cr, col[0], col[1], col[2]);
+    cairo_arc(cr, t.sx(c.x[i]), t.sy(c.y[i]), c.r[i] * t.scale, 0,
+              2 * std::numbers::pi);
+    cairo_fill(cr);
+  }
+}
+
+// Polígonos cerrados y rellenos (granos) o polilíneas abiertas (paredes);
+// sólo se dibujan los `i` con `keep(i)`
+template <bool Fill, typename ColorFn, typename Keep>
+void drawPolygons(cairo_t *cr, const PolygonColumns &p,
+                  const ScreenTransform &t, ColorFn &&color, Keep &&keep) {
+  forEachPolygon(p, [&](size_t i, uint32_t b, uint32_t e) {
+    if (b == e || !keep(i))
+      return;
+    std::array<double, 3> col = color(p.scalar[i]);
+    cairo_set_source_rgb(cr, col[0], col[1], col[2]);
+    cairo_move_to(cr, t.sx(p.vx[b]), t.sy(p.vy[b]));
+    for (uint32_t k = b + 1; k < e; ++k)
+      cairo_line_to(cr, t.sx(p.vx[k]), t.sy(p.vy[k]));
+    if constexpr (Fill) {
+      cairo_close_path(cr);
+      cairo_fill(cr);
+    } else {
+      cairo_stroke(cr);
+    }
+  });
+}
+
+template <bool Fill, typename ColorFn>
+void drawPolygons(cairo_t *cr, const PolygonColumns &p,
+                  const ScreenTransform &t, ColorFn &&color) {
+  drawPolygons<Fill>(cr, p, t, color, [](size_t) { return true; });
+}
+
+// ---- Huella de la geometría (FNV-1a) ----
+constexpr uint64_t kFnvOffset = 1469598103934665603ull;
+
+uint64_t fnv(uint64_t h, const void *data, size_t bytes) {
+  const auto *p = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < bytes; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+template <typename T> uint64_t fnv(uint64_t h, const T &value) {
+  return fnv(h, &value, sizeof(value));
+}
+
+// Vista de la superficie para SoftRaster; (x0, y0): su posición dentro de la
+// imagen completa
+PixelBuffer pixelsOf(cairo_surface_t *surface, int x0, int y0) {
+  PixelBuffer px;
+  px.data = reinterpret_cast<uint32_t *>(cairo_image_surface_get_data(surface));
+  px.width = cairo_image_surface_get_width(surface);
+  px.height = cairo_image_surface_get_height(surface);
+  px.stride = cairo_image_surface_get_stride(surface) / 4;
+  px.x0 = x0;
+  px.y0 = y0;
+  return px;
+}
+
+// Centro y área (en píxeles) de un polígono en pantalla cuya caja tiene
+// medio lado menor que `lod`; false si es más grande
+bool smallPolygon(const double *xs, const double *ys, size_t n, double lod,
+                  double &cx, double &cy, double &area) {
+  if (n == 0)
+    return false;
+  double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+  double sx = 0.0, sy = 0.0, a = 0.0;
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    minX = std::min(minX, xs[i]);
+    maxX = std::max(maxX, xs[i]);
+    minY = std::min(minY, ys[i]);
+    maxY = std::max(maxY, ys[i]);
+    sx += xs[i];
+    sy += ys[i];
+    a += xs[j] * ys[i] - xs[i] * ys[j];
+  }
+  if (std::max(maxX - minX, maxY - minY) >= 2.0 * lod)
+    return false;
+  cx = sx / static_cast<double>(n);
+  cy = sy / static_cast<double>(n);
+  area = std::abs(a) / 2.0;
+  return true;
+}
+
+// `src` premultiplicado (ARGB32 de Cairo) sobre `dst` con el operador OVER;
+// los cuatro canales en dos multiplicaciones, dividiendo por 255 redondeado
+inline uint32_t over(uint32_t dst, uint32_t src) {
+  const uint32_t inv = 255 - (src >> 24);
+  uint32_t rb = (dst & 0x00ff00ffu) * inv + 0x00800080u;
+  rb = ((rb + ((rb >> 8) & 0x00ff00ffu)) >> 8) & 0x00ff00ffu;
+  uint32_t ag = ((dst >> 8) & 0x00ff00ffu) * inv + 0x00800080u;
+  ag = (ag + ((ag >> 8) & 0x00ff00ffu)) & 0xff00ff00u;
+  return src + (rb | ag);
+}
+
+// Frames consecutivos sin cambios para considerar estática una pared
+constexpr unsigned kStaticAfter = 2;
+
+// Margen en píxeles alrededor de la imagen al descartar granos que no se
+// ven: antialiasing y medio ancho de línea de las paredes
+constexpr double kCullPad = 2.0;
+
+// Alto mínimo de una franja, en filas
+constexpr int kMinBand = 16;
+
+} // namespace
 
 Renderer::Renderer(int width, int height, double margin, double valmin,
-                   double valmax)
-    : width_(width), height_(height), margin_(margin), valmin_(valmin),
-      valmax_(valmax) {}
+                   double valmax, RenderBackend backend, bool batched,
+                   double lod)
+    : backend_(backend), batched_(batched), lod_(lod), width_(width),
+      height_(height), margin_(margin), valmin_(valmin), valmax_(valmax) {}
+
+Renderer::~Renderer() {
+  if (layer_)
+    cairo_surface_destroy(layer_);
+  if (overlay_)
+    cairo_surface_destroy(overlay_);
+}
+
+// ---------------- Canvas ----------------
+Canvas::Canvas(int width, int height)
+    : surface_(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height)),
+      cr_(cairo_create(surface_)) {}
+
+Canvas::~Canvas() {
+  cairo_destroy(cr_);
+  cairo_surface_destroy(surface_);
+}
 
 void Renderer::renderToPNG(const std::string &filename,
-                           const std::vector<std::unique_ptr<Grain>> &grains,
-                           double vmin, double vmax, double xmin, double xmax,
+                           const GrainStore &grains, double vmin, double vmax, double xmin, double xmax,
                            double ymin, double ymax, const Colormap &cmap,
                            const std::string &cbar_title,
                            const std::string &cbar_unit) {
-  // Crear superficie Cairo
-  cairo_surface_t *surface =
-      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width_, height_);
-  cairo_t *cr = cairo_create(surface);
+  cairo_surface_t *surface = render(grains, vmin, vmax, xmin, xmax, ymin, ymax,
+                                    cmap, cbar_title, cbar_unit);
+  writePNG(surface, filename);
+  cairo_surface_destroy(surface);
+}
+
+bool Renderer::writePNG(cairo_surface_t *surface, const std::string &filename) {
+  return cairo_surface_write_to_png(surface, filename.c_str()) ==
+         CAIRO_STATUS_SUCCESS;
+}
+
+cairo_surface_t *Renderer::render(const GrainStore &grains, double vmin,
+                                  double vmax, double xmin, double xmax,
+                                  double ymin, double ymax,
+                                  const Colormap &cmap,
+                                  const std::string &cbar_title,
+                                  const std::string &cbar_unit) {
+  Canvas canvas(width_, height_);
+  render(canvas, grains, nullptr, vmin, vmax, xmin, xmax, ymin, ymax, cmap,
+         cbar_title, cbar_unit);
+  // La superficie sobrevive al Canvas con su propia referencia
+  return cairo_surface_reference(canvas.surface());
+}
+
+void Renderer::render(Canvas &canvas, const GrainStore &all,
+                      const GrainIndex *index, double vmin, double vmax,
+                      double xmin, double xmax, double ymin, double ymax,
+                      const Colormap &cmap, const std::string &cbar_title,
+                      const std::string &cbar_unit) {
+  // Coordenadas físicas -> pantalla (centrado, relación de aspecto 1:1)
+  const ScreenTransform toScreen =
+      ScreenTransform::fit(width_, height_, margin_, xmin, xmax, ymin, ymax);
+  const bool banded = pool_ && bands_.size() > 1;
+  // En franjas cada una toma del índice sólo los granos que la tocan
+  const GrainStore &grains =
+      index && !banded ? visibleGrains(all, *index, toScreen) : all;
+
+  // El frame parte de un fondo blanco; las paredes estáticas van en la capa
+  classifyWalls(grains.walls);
+  updateLayer(grains, toScreen, cmap);
+  updateOverlay(cmap);
+  cairo_surface_t *surface = canvas.surface();
+  cairo_surface_flush(surface);
+  if (banded) {
+    renderBands(surface, grains, index, toScreen, cmap);
+  } else {
+    std::memset(cairo_image_surface_get_data(surface), 0xff,
+                static_cast<size_t>(cairo_image_surface_get_stride(surface)) *
+                    height_);
+    cairo_surface_mark_dirty(surface);
+    drawFrame(canvas.context(), surface, 0, grains, toScreen, cmap, scratch_);
+  }
+  cairo_surface_flush(surface);
+}
+
+void Renderer::drawFrame(cairo_t *cr, cairo_surface_t *surface, int y0,
+                         const GrainStore &grains,
+                         const ScreenTransform &toScreen, const Colormap &cmap,
+                         Scratch &scratch) {
+  auto color = [&](double value) { return cmap(value, valmin_, valmax_); };
+  cairo_save(cr);
+
+  // Dibujar granos y, encima, las paredes: las estáticas de la capa y las que
+  // se movieron
+  drawGrains(cr, surface, 0, y0, grains, toScreen, cmap, scratch);
+  cairo_surface_flush(surface);
+  drawLayer(surface, y0);
+  cairo_surface_mark_dirty(surface);
+  cairo_set_line_width(cr, 2);
+  drawPolygons<false>(cr, grains.walls, toScreen, color,
+                      [&](size_t i) { return !static_[i]; });
+
+  cairo_restore(cr);
+
+  // Barra de escala de colores, encima de todo
+  cairo_surface_flush(surface);
+  drawOverlay(surface, y0);
+  cairo_surface_mark_dirty(surface);
+}
+
+void Renderer::drawGrains(cairo_t *cr, cairo_surface_t *surface, int x0,
+                          int y0, const GrainStore &grains,
+                          const ScreenTransform &toScreen,
+                          const Colormap &cmap, Scratch &scratch) {
+  if (backend_ == RenderBackend::Soft) {
+    rasterizeSoft(surface, x0, y0, grains, toScreen, cmap, scratch);
+    return;
+  }
+  splatSmall(surface, x0, y0, grains, toScreen, cmap, scratch);
+  if (batched_) {
+    fillBatched(cr, grains, toScreen, cmap, scratch);
+    return;
+  }
+  auto color = [&](double value) { return cmap(value, valmin_, valmax_); };
+  fillCircles(cr, grains.circles, toScreen, color, [&](size_t i) {
+    return scratch.smallCircles.empty() || !scratch.smallCircles[i];
+  });
+  drawPolygons<true>(cr, grains.polygons, toScreen, color, [&](size_t i) {
+    return scratch.smallPolygons.empty() || !scratch.smallPolygons[i];
+  });
+}
+
+void Renderer::renderTile(Canvas &canvas, int x0, int y0,
+                          const GrainStore &grains, double xmin, double xmax,
+                          double ymin, double ymax, const Colormap &cmap) {
+  const ScreenTransform toScreen =
+      ScreenTransform::fit(width_, height_, margin_, xmin, xmax, ymin, ymax);
+  auto color = [&](double value) { return cmap(value, valmin_, valmax_); };
+  cairo_surface_t *surface = canvas.surface();
+  cairo_t *cr = canvas.context();
 
   // Fondo blanco
+  cairo_save(cr);
   cairo_set_source_rgb(cr, 1, 1, 1);
   cairo_paint(cr);
+  cairo_surface_flush(surface);
 
-  // Corregir rangos si están invertidos
-  if (xmax < xmin)
-    std::swap(xmax, xmin);
-  if (ymax < ymin)
-    std::swap(ymax, ymin);
-
-  // Calcular área disponible para el dibujo
-  double available_width = width_ - 2 * margin_;
-  double available_height = height_ - 2 * margin_;
-
-  // Calcular escalas manteniendo relación de aspecto
-  double scaleX = available_width / (xmax - xmin);
-  double scaleY = available_height / (ymax - ymin);
-  double scale = std::min(scaleX, scaleY);
-
-  // Calcular offsets para centrar
-  double offsetX = 0, offsetY = 0;
-  if (scaleX > scaleY) {
-    // Espacio sobrante a los lados (formato horizontal)
-    offsetX = (width_ - 2 * margin_ - (xmax - xmin) * scale) / 2;
-  } else {
-    // Espacio sobrante arriba/abajo (formato vertical)
-    offsetY = (height_ - 2 * margin_ - (ymax - ymin) * scale) / 2;
-  }
+  // Lo demás se dibuja en coordenadas de la imagen completa
+  cairo_translate(cr, -x0, -y0);
+  drawGrains(cr, surface, x0, y0, grains, toScreen, cmap, scratch_);
+  cairo_set_line_width(cr, 2);
+  drawPolygons<false>(cr, grains.walls, toScreen, color);
+
+  // Barra de colores, sólo en los tiles que la tocan (con lugar para las
+  // etiquetas a la derecha y el título debajo)
+  double bx, by, bw, bh;
+  colorbarRect(bx, by, bw, bh);
+  const int tw = cairo_image_surface_get_width(surface);
+  const int th = cairo_image_surface_get_height(surface);
+  if (x0 + tw > bx - 10 && y0 + th > by - 10 && y0 < by + bh + 60)
+    drawColorbar(cr, bx, by, bw, bh, valmin_, valmax_, cmap, "Pressure", "N/m");
+
+  cairo_restore(cr);
+  cairo_surface_flush(surface);
+}
 
-  // Función para convertir coordenadas físicas a pantalla (CENTRADO)
-  auto toScreen = [&](double x, double y) {
-    double sx = margin_ + offsetX + (x - xmin) * scale;
-    double sy = height_ - margin_ - offsetY - (y - ymin) * scale;
-    return std::make_pair(sx, sy);
+// ---------------- Franjas en paralelo ----------------
+void Renderer::setBands(ThreadPool *pool, int bands) {
+  pool_ = pool;
+  bands_.resize(std::clamp(bands, 1, std::max(1, height_ / kMinBand)));
+  if (bands_.size() == 1)
+    bands_.clear();
+}
+
+void Renderer::renderBands(cairo_surface_t *surface, const GrainStore &grains,
+                           const GrainIndex *index,
+                           const ScreenTransform &toScreen,
+                           const Colormap &cmap) {
+  unsigned char *data = cairo_image_surface_get_data(surface);
+  const size_t stride = cairo_image_surface_get_stride(surface);
+  const int n = static_cast<int>(bands_.size());
+
+  auto band = [&](int b) {
+    const int y0 = height_ * b / n, y1 = height_ * (b + 1) / n;
+    Scratch &scratch = bands_[b];
+    std::memset(data + y0 * stride, 0xff, (y1 - y0) * stride);
+
+    // Los granos que tocan la franja, con todas las paredes (static_ las
+    // sigue por posición)
+    const GrainStore *own = &grains;
+    if (index) {
+      const GrainBox region{toScreen.wx(-kCullPad), toScreen.wy(y1 + kCullPad),
+                            toScreen.wx(width_ + kCullPad),
+                            toScreen.wy(y0 - kCullPad)};
+      index->query(region, scratch.selection);
+      scratch.selection.walls.resize(grains.walls.size());
+      std::iota(scratch.selection.walls.begin(),
+                scratch.selection.walls.end(), 0u);
+      copySelection(grains, scratch.selection, scratch.grains);
+      own = &scratch.grains;
+    }
+
+    // Superficie sobre las filas de la franja: Cairo recorta en su borde y
+    // ninguna franja escribe en las de las otras
+    cairo_surface_t *view = cairo_image_surface_create_for_data(
+        data + y0 * stride, CAIRO_FORMAT_ARGB32, width_, y1 - y0,
+        static_cast<int>(stride));
+    cairo_t *cr = cairo_create(view);
+    cairo_translate(cr, 0, -y0);
+    drawFrame(cr, view, y0, *own, toScreen, cmap, scratch);
+    cairo_destroy(cr);
+    cairo_surface_destroy(view);
   };
 
-  // Dibujar granos
-  for (const auto &g : grains) {
-    double value = g->scalar();
-    std::array<double, 3> col = cmap(value, valmin_, valmax_);
-    // std::array<double, 3> col = cmap(value, vmin, vmax);
+  std::vector<std::future<void>> done;
+  done.reserve(n);
+  for (int b = 0; b < n; ++b)
+    done.push_back(pool_->enqueue([&band, b] { band(b); }));
+  // Todas terminan antes de propagar un error: usan el canvas y los granos
+  for (auto &f : done)
+    f.wait();
+  cairo_surface_mark_dirty(surface);
+  for (auto &f : done)
+    f.get();
+}
 
-    cairo_set_source_rgb(cr, col[0], col[1], col[2]);
-    // cairo_set_source_rgb(cr, col.r, col.g, col.b);
-    g->render(cr, toScreen, scale);
+// ---------------- Granos visibles ----------------
+const GrainStore &Renderer::visibleGrains(const GrainStore &grains,
+                                          const GrainIndex &index,
+                                          const ScreenTransform &toScreen) {
+  const GrainBox view{toScreen.wx(-kCullPad), toScreen.wy(height_ + kCullPad),
+                      toScreen.wx(width_ + kCullPad), toScreen.wy(-kCullPad)};
+  if (view.contains(index.bounds()))
+    return grains;
+
+  index.query(view, selection_);
+  // Las paredes van todas: la capa las sigue por posición
+  selection_.walls.resize(grains.walls.size());
+  for (uint32_t i = 0; i < selection_.walls.size(); ++i)
+    selection_.walls[i] = i;
+  copySelection(grains, selection_, visible_);
+  return visible_;
+}
+
+// ---------------- Capa de paredes estáticas ----------------
+void Renderer::classifyWalls(const PolygonColumns &walls) {
+  walls_.resize(walls.size(), WallTrack{0, 0, 0});
+  static_.assign(walls.size(), 0);
+  forEachPolygon(walls, [&](size_t i, uint32_t b, uint32_t e) {
+    uint64_t h = fnv(kFnvOffset, walls.gid[i]);
+    h = fnv(h, walls.vx.data() + b, (e - b) * sizeof(double));
+    h = fnv(h, walls.vy.data() + b, (e - b) * sizeof(double));
+
+    WallTrack &w = walls_[i];
+    if (w.frames > 0 && w.gid == walls.gid[i] && w.hash == h)
+      ++w.frames;
+    else
+      w = {walls.gid[i], h, 1};
+    static_[i] = w.frames >= kStaticAfter;
+  });
+}
+
+void Renderer::updateLayer(const GrainStore &grains,
+                           const ScreenTransform &toScreen,
+                           const Colormap &cmap) {
+  // La capa depende de la vista, el colormap y qué paredes estáticas tiene
+  uint64_t key = fnv(kFnvOffset, cmap.hash());
+  key = fnv(key, toScreen.scale);
+  key = fnv(key, toScreen.left);
+  key = fnv(key, toScreen.bottom);
+  key = fnv(key, toScreen.xmin);
+  key = fnv(key, toScreen.ymin);
+  for (size_t i = 0; i < static_.size(); ++i)
+    if (static_[i]) {
+      key = fnv(key, i);
+      key = fnv(key, walls_[i].hash);
+    }
+  if (layer_ && key == layerKey_)
+    return;
+
+  if (!layer_)
+    layer_ = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width_, height_);
+  cairo_t *cr = cairo_create(layer_);
+  cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+  // Paredes estáticas
+  auto color = [&](double value) { return cmap(value, valmin_, valmax_); };
+  cairo_set_line_width(cr, 2);
+  drawPolygons<false>(cr, grains.walls, toScreen, color,
+                      [&](size_t i) { return static_[i] != 0; });
+
+  cairo_destroy(cr);
+  cairo_surface_flush(layer_);
+
+  // Sólo se componen los tramos de cada fila con píxeles no transparentes
+  layerRuns_.clear();
+  const unsigned char *data = cairo_image_surface_get_data(layer_);
+  const int stride = cairo_image_surface_get_stride(layer_);
+  for (int y = 0; y < height_; ++y) {
+    const auto *row = reinterpret_cast<const uint32_t *>(data + y * stride);
+    for (int x = 0; x < width_;) {
+      if (!(row[x] >> 24)) {
+        ++x;
+        continue;
+      }
+      const int x0 = x;
+      while (x < width_ && row[x] >> 24)
+        ++x;
+      layerRuns_.push_back({y, x0, x});
+    }
   }
+  layerKey_ = key;
+}
 
-  // Dibujar barra de escala de colores
-  double colorbar_width = 30;                           // Ancho de la barra
-  double colorbar_height = height_ - 2 * margin_ - 100; // Alto de la barra
-  double colorbar_x = width_ - margin_ - colorbar_width - 20; // Posición X
-  double colorbar_y = margin_ + 50;                           // Posición Y
+void Renderer::drawLayer(cairo_surface_t *surface, int y0) const {
+  unsigned char *data = cairo_image_surface_get_data(surface);
+  const unsigned char *layer = cairo_image_surface_get_data(layer_);
+  const int stride = cairo_image_surface_get_stride(surface);
+  const int layerStride = cairo_image_surface_get_stride(layer_);
+  const int y1 = y0 + cairo_image_surface_get_height(surface);
+  // Los tramos están ordenados por fila
+  auto it = std::lower_bound(
+      layerRuns_.begin(), layerRuns_.end(), y0,
+      [](const LayerRun &r, int y) { return r.y < y; });
+  for (; it != layerRuns_.end() && it->y < y1; ++it) {
+    auto *dst = reinterpret_cast<uint32_t *>(data + (it->y - y0) * stride);
+    const auto *src =
+        reinterpret_cast<const uint32_t *>(layer + it->y * layerStride);
+    for (int x = it->x0; x < it->x1; ++x)
+      dst[x] = over(dst[x], src[x]);
+  }
+}
+
+// ---------------- Barra de colores ----------------
+void Renderer::updateOverlay(const Colormap &cmap) {
+  uint64_t key = fnv(kFnvOffset, cmap.hash());
+  key = fnv(key, valmin_);
+  key = fnv(key, valmax_);
+  key = fnv(key, width_);
+  key = fnv(key, height_);
+  if (overlay_ && key == overlayKey_)
+    return;
+
+  if (!overlay_)
+    overlay_ = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width_, height_);
+  cairo_t *cr = cairo_create(overlay_);
+  cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
 
+  // Dibujar barra de escala de colores
+  double colorbar_x, colorbar_y, colorbar_width, colorbar_height;
+  colorbarRect(colorbar_x, colorbar_y, colorbar_width, colorbar_height);
   drawColorbar(cr, colorbar_x, colorbar_y, colorbar_width, colorbar_height,
                valmin_, valmax_, cmap, "Pressure", "N/m");
+  cairo_destroy(cr);
+  cairo_surface_flush(overlay_);
+
+  // Sólo se compone el rectángulo con píxeles no transparentes
+  const unsigned char *data = cairo_image_surface_get_data(overlay_);
+  const int stride = cairo_image_surface_get_stride(overlay_);
+  int x0 = width_, y0 = height_, x1 = -1, y1 = -1;
+  for (int y = 0; y < height_; ++y) {
+    const auto *row = reinterpret_cast<const uint32_t *>(data + y * stride);
+    for (int x = 0; x < width_; ++x)
+      if (row[x] >> 24) {
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x);
+        y0 = std::min(y0, y);
+        y1 = std::max(y1, y);
+      }
+  }
+  overlayX_ = x0;
+  overlayY_ = y0;
+  overlayW_ = x1 - x0 + 1;
+  overlayH_ = y1 - y0 + 1;
+  overlayKey_ = key;
+}
+
+void Renderer::drawOverlay(cairo_surface_t *surface, int y0) const {
+  // Se copian los píxeles a mano, sin usar overlay_ como fuente de Cairo: las
+  // franjas la componen a la vez desde varios hilos
+  if (overlayW_ <= 0 || overlayH_ <= 0)
+    return;
+  unsigned char *data = cairo_image_surface_get_data(surface);
+  const unsigned char *overlay = cairo_image_surface_get_data(overlay_);
+  const int stride = cairo_image_surface_get_stride(surface);
+  const int overlayStride = cairo_image_surface_get_stride(overlay_);
+  const int top = std::max(overlayY_, y0);
+  const int bottom = std::min(overlayY_ + overlayH_,
+                              y0 + cairo_image_surface_get_height(surface));
+  for (int y = top; y < bottom; ++y) {
+    auto *dst = reinterpret_cast<uint32_t *>(data + (y - y0) * stride);
+    const auto *src =
+        reinterpret_cast<const uint32_t *>(overlay + y * overlayStride);
+    for (int x = overlayX_; x < overlayX_ + overlayW_; ++x)
+      if (src[x])
+        dst[x] = over(dst[x], src[x]);
+  }
+}
 
-  // Guardar en archivo
-  cairo_surface_write_to_png(surface, filename.c_str());
+void Renderer::colorbarRect(double &x, double &y, double &w,
+                            double &h) const {
+  w = 30;                           // Ancho de la barra
+  h = height_ - 2 * margin_ - 100;  // Alto de la barra
+  x = width_ - margin_ - w - 20;    // Posición X
+  y = margin_ + 50;                 // Posición Y
+}
 
-  cairo_destroy(cr);
-  cairo_surface_destroy(surface);
+// ---------------- Relleno por color ----------------
+void Renderer::LevelBuckets::build(const Colormap &cmap,
+                                   std::span<const double> scalars,
+                                   double vmin, double vmax) {
+  level.resize(scalars.size());
+  cmap.mapLevels(scalars, vmin, vmax, level.data());
+
+  start.assign(Colormap::kLutSize + 1, 0);
+  for (uint16_t l : level)
+    ++start[l + 1];
+  for (size_t l = 1; l < start.size(); ++l)
+    start[l] += start[l - 1];
+
+  order.resize(scalars.size());
+  for (uint32_t i = 0; i < level.size(); ++i)
+    order[start[level[i]]++] = i;
+  // Ahora start[l] es el final del nivel l, que es el comienzo del l+1
+  std::copy_backward(start.begin(), start.end() - 1, start.end());
+  start[0] = 0;
+}
+
+// Varios niveles de la tabla dan el mismo color de 8 bits: se rellena una vez
+// por cada tramo de niveles con el mismo color, con todos sus granos (círculos
+// y polígonos) como subcaminos de un único camino
+void Renderer::fillBatched(cairo_t *cr, const GrainStore &grains,
+                           const ScreenTransform &t, const Colormap &cmap,
+                           Scratch &scratch) {
+  const CircleColumns &c = grains.circles;
+  const PolygonColumns &p = grains.polygons;
+  LevelBuckets &circleBuckets = scratch.circleBuckets;
+  LevelBuckets &polygonBuckets = scratch.polygonBuckets;
+  const std::vector<char> &smallCircles = scratch.smallCircles;
+  const std::vector<char> &smallPolygons = scratch.smallPolygons;
+  circleBuckets.build(cmap, c.scalar, valmin_, valmax_);
+  polygonBuckets.build(cmap, p.scalar, valmin_, valmax_);
+
+  const Colormap::Lut &lut = cmap.lut();
+  bool pending = false;
+  for (size_t l = 0; l < lut.size(); ++l) {
+    if (pending && lut[l] != lut[l - 1]) {
+      cairo_fill(cr);
+      pending = false;
+    }
+    auto circles = circleBuckets.bucket(l);
+    auto polygons = polygonBuckets.bucket(l);
+    if (circles.empty() && polygons.empty())
+      continue;
+    if (!pending) {
+      std::array<double, 3> col = Colormap::unpack(lut[l]);
+      cairo_set_source_rgb(cr, col[0], col[1], col[2]);
+      pending = true;
+    }
+    for (uint32_t i : circles) {
+      if (!smallCircles.empty() && smallCircles[i])
+        continue;
+      cairo_new_sub_path(cr);
+      cairo_arc(cr, t.sx(c.x[i]), t.sy(c.y[i]), c.r[i] * t.scale, 0,
+                2 * std::numbers::pi);
+    }
+    for (uint32_t i : polygons) {
+      const uint32_t b = p.offset[i], e = p.offset[i + 1];
+      if (b == e || (!smallPolygons.empty() && smallPolygons[i]))
+        continue;
+      cairo_move_to(cr, t.sx(p.vx[b]), t.sy(p.vy[b]));
+      for (uint32_t k = b + 1; k < e; ++k)
+        cairo_line_to(cr, t.sx(p.vx[k]), t.sy(p.vy[k]));
+      cairo_close_path(cr);
+    }
+  }
+  if (pending)
+    cairo_fill(cr);
+}
+
+// ---------------- Backend Soft ----------------
+void Renderer::rasterizeSoft(cairo_surface_t *surface, int x0, int y0,
+                             const GrainStore &grains,
+                             const ScreenTransform &toScreen,
+                             const Colormap &cmap, Scratch &scratch) {
+  const PixelBuffer px = pixelsOf(surface, x0, y0);
+  std::vector<double> &xs = scratch.sx, &ys = scratch.sy;
+  std::vector<uint32_t> &colors = scratch.colors;
+
+  // Colores de cada tipo en una sola pasada por la tabla del colormap
+  const CircleColumns &c = grains.circles;
+  colors.resize(c.size());
+  cmap.mapColors(c.scalar, valmin_, valmax_, colors.data());
+  for (size_t i = 0; i < c.size(); ++i) {
+    const double r = c.r[i] * toScreen.scale;
+    const double sx = toScreen.sx(c.x[i]), sy = toScreen.sy(c.y[i]);
+    if (r < lod_)
+      SoftRaster::splat(px, sx, sy, SoftRaster::discInk(r), colors[i]);
+    else
+      SoftRaster::fillDisc(px, sx, sy, r, colors[i]);
+  }
+
+  const PolygonColumns &p = grains.polygons;
+  colors.resize(p.size());
+  cmap.mapColors(p.scalar, valmin_, valmax_, colors.data());
+  forEachPolygon(p, [&](size_t i, uint32_t b, uint32_t e) {
+    xs.clear();
+    ys.clear();
+    for (uint32_t k = b; k < e; ++k) {
+      xs.push_back(toScreen.sx(p.vx[k]));
+      ys.push_back(toScreen.sy(p.vy[k]));
+    }
+    // Con la tinta de un disco de la misma área, como la que deja la rampa
+    // de fillConvex en un polígono chico
+    double cx, cy, area;
+    if (lod_ > 0.0 &&
+        smallPolygon(xs.data(), ys.data(), xs.size(), lod_, cx, cy, area))
+      SoftRaster::splat(px, cx, cy,
+                        SoftRaster::discInk(std::sqrt(area / std::numbers::pi)),
+                        colors[i]);
+    else
+      SoftRaster::fillConvex(px, xs.data(), ys.data(), xs.size(), colors[i]);
+  });
+
+  // Cairo debe releer los píxeles escritos por fuera
+  cairo_surface_mark_dirty(surface);
+}
+
+// ---------------- Nivel de detalle ----------------
+void Renderer::splatSmall(cairo_surface_t *surface, int x0, int y0,
+                          const GrainStore &grains,
+                          const ScreenTransform &toScreen,
+                          const Colormap &cmap, Scratch &scratch) {
+  std::vector<char> &smallCircles = scratch.smallCircles;
+  std::vector<char> &smallPolygons = scratch.smallPolygons;
+  std::vector<double> &xs = scratch.sx, &ys = scratch.sy;
+  std::vector<uint32_t> &colors = scratch.colors;
+  smallCircles.clear();
+  smallPolygons.clear();
+  if (!(lod_ > 0.0))
+    return;
+  cairo_surface_flush(surface);
+  const PixelBuffer px = pixelsOf(surface, x0, y0);
+
+  // Cairo cubre exactamente el área de cada grano: la huella lleva esa tinta
+  const CircleColumns &c = grains.circles;
+  smallCircles.assign(c.size(), 0);
+  colors.resize(c.size());
+  cmap.mapColors(c.scalar, valmin_, valmax_, colors.data());
+  for (size_t i = 0; i < c.size(); ++i) {
+    const double r = c.r[i] * toScreen.scale;
+    if (r >= lod_)
+      continue;
+    SoftRaster::splat(px, toScreen.sx(c.x[i]), toScreen.sy(c.y[i]),
+                      std::numbers::pi * r * r, colors[i]);
+    smallCircles[i] = 1;
+  }
+
+  const PolygonColumns &p = grains.polygons;
+  smallPolygons.assign(p.size(), 0);
+  colors.resize(p.size());
+  cmap.mapColors(p.scalar, valmin_, valmax_, colors.data());
+  forEachPolygon(p, [&](size_t i, uint32_t b, uint32_t e) {
+    xs.clear();
+    ys.clear();
+    for (uint32_t k = b; k < e; ++k) {
+      xs.push_back(toScreen.sx(p.vx[k]));
+      ys.push_back(toScreen.sy(p.vy[k]));
+    }
+    double cx, cy, area;
+    if (!smallPolygon(xs.data(), ys.data(), xs.size(), lod_, cx, cy, area))
+      return;
+    SoftRaster::splat(px, cx, cy, area, colors[i]);
+    smallPolygons[i] = 1;
+  });
+
+  cairo_surface_mark_dirty(surface);
 }
 
 void Renderer::drawColorbar(cairo_t *cr, double x, double y, double width,
@@ -0,0 +1,228 @@
+#include "run_manifest.hpp"
+#include "frame_pipeline.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kVersion = 2;
+
+// Nombre con el que se registra un frame: el del PNG de salida
+std::string_view frameKey(const FrameJob &job) {
+  std::string_view out = job.outFile;
+  const size_t slash = out.find_last_of('/');
+  return slash == std::string_view::npos ? out : out.substr(slash + 1);
+}
+
+void stamp(const std::string &file, uint64_t &size, int64_t &mtime) {
+  std::error_code ec;
+  auto sz = fs::file_size(file, ec);
+  if (ec)
+    return;
+  auto t = fs::last_write_time(file, ec);
+  if (ec)
+    return;
+  size = sz;
+  mtime = t.time_since_epoch().count();
+}
+
+} // namespace
+
+// ---------------- RunManifest ----------------
+RunManifest::RunManifest(const std::string &outputDir, uint64_t paramsHash,
+                         MagnitudeHistogram &histogram, size_t checkpointEvery)
+    : manifestFile_((fs::path(outputDir) / "render_manifest.txt").string()),
+      checkpointFile_((fs::path(outputDir) / "histogram_checkpoint.bin").string()),
+      paramsHash_(paramsHash), histogram_(histogram),
+      checkpointEvery_(std::max<size_t>(1, checkpointEvery)) {}
+
+InputFingerprint RunManifest::fingerprint(const FrameJob &job) {
+  InputFingerprint fp;
+  stamp(job.frameFile, fp.frameSize, fp.frameMtime);
+  // Con .gfb se registran igual: si cambian, el binario quedó viejo
+  stamp(job.valuesFile, fp.valuesSize, fp.valuesMtime);
+  if (!job.otherValuesFile.empty())
+    stamp(job.otherValuesFile, fp.otherSize, fp.otherMtime);
+  return fp;
+}
+
+uint64_t RunManifest::hashParams(const std::string &signature) {
+  uint64_t h = 1469598103934665603ull;
+  for (unsigned char c : signature) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+void RunManifest::load() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_.clear();
+  std::ifstream fin(manifestFile_);
+  if (!fin)
+    return;
+
+  std::string line, key;
+  int version = 0;
+  uint64_t params = 0;
+  Frames entries;
+  while (std::getline(fin, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream ss(line);
+    ss >> key;
+    if (key == "version") {
+      ss >> version;
+    } else if (key == "params") {
+      ss >> std::hex >> params;
+    } else if (key == "generation") {
+      ss >> generation_;
+    } else if (key == "frame") {
+      InputFingerprint fp;
+      std::string name;
+      ss >> fp.frameSize >> fp.frameMtime >> fp.valuesSize >> fp.valuesMtime >>
+          fp.otherSize >> fp.otherMtime;
+      ss >> std::ws;
+      std::getline(ss, name);
+      if (ss.fail() && name.empty())
+        continue;
+      entries[name] = fp;
+    }
+  }
+
+  // Otros parámetros de render: nada de lo registrado sirve. La generación
+  // se conserva para que el checkpoint viejo nunca vuelva a coincidir.
+  if (version != kVersion || params != paramsHash_) {
+    if (!entries.empty())
+      std::cout << "[INFO] Render parameters changed; re-rendering all frames\n";
+    return;
+  }
+  done_ = std::move(entries);
+}
+
+bool RunManifest::isRecorded(const FrameJob &job) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = done_.find(frameKey(job));
+  return it != done_.end() && it->second == job.fingerprint;
+}
+
+bool RunManifest::restoreHistogram(const std::vector<FrameJob> &jobs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  histogram_.clear();
+  if (done_.empty())
+    return true;
+
+  // Cada frame incluido en el checkpoint tiene que seguir existiendo con las
+  // mismas entradas; si no, su aporte a las sumas ya no es válido
+  size_t matched = 0;
+  for (const auto &job : jobs) {
+    auto it = done_.find(frameKey(job));
+    if (it == done_.end())
+      continue;
+    if (!(it->second == job.fingerprint))
+      break;
+    ++matched;
+  }
+  if (matched == done_.size() &&
+      histogram_.loadState(checkpointFile_, generation_))
+    return true;
+
+  histogram_.clear();
+  done_.clear();
+  return false;
+}
+
+void RunManifest::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  histogram_.clear();
+  done_.clear();
+}
+
+void RunManifest::commit(const FrameJob &job,
+                         const MagnitudeHistogram::Points &points) {
+  bool due = false;
+  {
+    // Los puntos van al fragmento del hilo, sin locks; un checkpoint espera a
+    // que terminen los commits en curso, así nunca incluye frames a medias
+    std::shared_lock<std::shared_mutex> gate(gate_);
+    if (job.histogram)
+      histogram_.addPoints(points);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string_view key = frameKey(job);
+    auto it = done_.find(key);
+    if (it != done_.end())
+      it->second = job.fingerprint;
+    else
+      done_.emplace(std::string(key), job.fingerprint);
+    due = ++sinceCheckpoint_ >= checkpointEvery_;
+    if (due)
+      sinceCheckpoint_ = 0;
+  }
+  if (due)
+    checkpoint();
+}
+
+void RunManifest::checkpoint() {
+  // Un checkpoint a la vez: el siguiente reduciría sobre las sumas que éste
+  // está escribiendo
+  std::lock_guard<std::mutex> writing(writeMutex_);
+  Frames done;
+  uint64_t generation;
+  {
+    // Sin commits en curso se juntan los fragmentos y se copian los frames
+    // que les corresponden; los archivos se escriben con los commits andando
+    std::unique_lock<std::shared_mutex> gate(gate_);
+    histogram_.reduce();
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = ++generation_;
+    done = done_;
+  }
+  write(generation, done);
+}
+
+void RunManifest::write(uint64_t generation, const Frames &done) {
+  try {
+    histogram_.saveState(checkpointFile_, generation);
+  } catch (const std::exception &e) {
+    // El manifest se escribe igual: en la próxima corrida el checkpoint no
+    // coincidirá y sólo habrá que recalcular el histograma
+    std::cerr << "[WARN] Could not write histogram checkpoint: " << e.what()
+              << "\n";
+  }
+
+  std::string tmp = manifestFile_ + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out) {
+      std::cerr << "Error al abrir " << tmp << "\n";
+      return;
+    }
+    out << "# granular_cmap_render manifest\n";
+    out << "version " << kVersion << "\n";
+    out << "params " << std::hex << std::setw(16) << std::setfill('0')
+        << paramsHash_ << std::dec << "\n";
+    out << "generation " << generation << "\n";
+    out << "# frame <frame_size> <frame_mtime> <values_size> <values_mtime> "
+           "<other_size> <other_mtime> <png>\n";
+    for (const auto &[name, fp] : done)
+      out << "frame " << fp.frameSize << ' ' << fp.frameMtime << ' '
+          << fp.valuesSize << ' ' << fp.valuesMtime << ' ' << fp.otherSize
+          << ' ' << fp.otherMtime << ' ' << name << "\n";
+    if (!out) {
+      std::cerr << "[WARN] Could not write " << tmp << "\n";
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), manifestFile_.c_str()) != 0) {
+    std::cerr << "[WARN] Could not replace " << manifestFile_ << "\n";
+    std::remove(tmp.c_str());
+  }
+}
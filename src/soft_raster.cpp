@@ -0,0 +1,250 @@
+#include "soft_raster.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Mezcla `src` opaco sobre `dst` con cobertura `cov` en [0, 256]; los cuatro
+// canales en dos multiplicaciones (R y B juntos, A y G juntos)
+inline uint32_t blend(uint32_t dst, uint32_t src, uint32_t cov) {
+  const uint32_t inv = 256 - cov;
+  const uint32_t rb =
+      (((src & 0x00ff00ffu) * cov + (dst & 0x00ff00ffu) * inv) >> 8) &
+      0x00ff00ffu;
+  const uint32_t ag =
+      (((src >> 8) & 0x00ff00ffu) * cov + ((dst >> 8) & 0x00ff00ffu) * inv) &
+      0xff00ff00u;
+  return rb | ag;
+}
+
+inline uint32_t coverage(double c) {
+  return static_cast<uint32_t>(std::clamp(c, 0.0, 1.0) * 256.0 + 0.5);
+}
+
+inline void blendPixel(uint32_t *p, uint32_t color, double c) {
+  const uint32_t cov = coverage(c);
+  if (cov >= 256)
+    *p = color;
+  else if (cov > 0)
+    *p = blend(*p, color, cov);
+}
+
+// Píxeles cuyo centro cae en [lo, hi]
+inline int firstCentre(double lo) {
+  return static_cast<int>(std::ceil(lo - 0.5));
+}
+inline int lastCentre(double hi) {
+  return static_cast<int>(std::floor(hi - 0.5));
+}
+
+// Semiplano de una arista: d(p) = a*x + b*y + c es la distancia con signo del
+// punto a la recta (positiva hacia adentro)
+struct Edge {
+  double a, b, c;
+};
+
+} // namespace
+
+namespace SoftRaster {
+
+void fillSpan(uint32_t *dst, size_t n, uint32_t color) {
+#if defined(__AVX2__)
+  const __m256i v = _mm256_set1_epi32(static_cast<int>(color));
+  for (; n >= 8; n -= 8, dst += 8)
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), v);
+#elif defined(__SSE2__)
+  const __m128i v = _mm_set1_epi32(static_cast<int>(color));
+  for (; n >= 4; n -= 4, dst += 4)
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), v);
+#endif
+  for (; n > 0; --n)
+    *dst++ = color;
+}
+
+// ---------------- Discos ----------------
+// Cobertura = r + 1/2 - distancia al centro, recortada a [0, 1]. En cada fila
+// los píxeles a menos de r - 1/2 están cubiertos del todo y los que están a
+// más de r + 1/2 no se tocan.
+void fillDisc(const PixelBuffer &buf, double cx, double cy, double r,
+              uint32_t color) {
+  if (!(r > 0.0))
+    return;
+  const double rOut = r + 0.5, rIn = r - 0.5;
+  const int xLo = buf.x0, xHi = buf.x0 + buf.width - 1;
+  const int yBeg = std::max(buf.y0, firstCentre(cy - rOut));
+  const int yEnd = std::min(buf.y0 + buf.height - 1, lastCentre(cy + rOut));
+
+  for (int y = yBeg; y <= yEnd; ++y) {
+    const double dy = y + 0.5 - cy;
+    if (std::abs(dy) >= rOut)
+      continue;
+    const double hwOut = std::sqrt(rOut * rOut - dy * dy);
+    const int xa = std::max(xLo, firstCentre(cx - hwOut));
+    const int xb = std::min(xHi, lastCentre(cx + hwOut));
+    if (xa > xb)
+      continue;
+
+    int ia = xb + 1, ib = xb; // tramo interior (vacío por defecto)
+    if (rIn > 0.0 && std::abs(dy) < rIn) {
+      const double hwIn = std::sqrt(rIn * rIn - dy * dy);
+      ia = std::max(xa, firstCentre(cx - hwIn));
+      ib = std::min(xb, lastCentre(cx + hwIn));
+      if (ia > ib) {
+        ia = xb + 1;
+        ib = xb;
+      }
+    }
+
+    uint32_t *row = buf.row(y);
+    auto edge = [&](int x) {
+      const double dx = x + 0.5 - cx;
+      blendPixel(row + x, color, rOut - std::sqrt(dx * dx + dy * dy));
+    };
+    for (int x = xa; x < ia; ++x)
+      edge(x);
+    if (ia <= ib)
+      fillSpan(row + ia, static_cast<size_t>(ib - ia + 1), color);
+    for (int x = std::max(ib + 1, ia); x <= xb; ++x)
+      edge(x);
+  }
+}
+
+// ---------------- Huellas de granos chicos ----------------
+// Integral de clamp(r + 1/2 - d, 0, 1) en el plano
+double discInk(double r) {
+  if (!(r > 0.0))
+    return 0.0;
+  const double pi = std::numbers::pi;
+  if (r < 0.5)
+    return pi * (r + 0.5) * (r + 0.5) * (r + 0.5) / 3.0;
+  return pi * r * r + pi / 12.0;
+}
+
+void splat(const PixelBuffer &buf, double cx, double cy, double area,
+           uint32_t color) {
+  if (!(area > 0.0))
+    return;
+  const double fx = cx - 0.5, fy = cy - 0.5;
+  const double ix = std::floor(fx), iy = std::floor(fy);
+  const double tx = fx - ix, ty = fy - iy;
+  const int x = static_cast<int>(ix), y = static_cast<int>(iy);
+  const double wx[2] = {1.0 - tx, tx}, wy[2] = {1.0 - ty, ty};
+  for (int j = 0; j < 2; ++j) {
+    const int py = y + j;
+    if (py < buf.y0 || py >= buf.y0 + buf.height)
+      continue;
+    uint32_t *row = buf.row(py);
+    for (int i = 0; i < 2; ++i) {
+      const int px = x + i;
+      if (px >= buf.x0 && px < buf.x0 + buf.width)
+        blendPixel(row + px, color, area * wx[i] * wy[j]);
+    }
+  }
+}
+
+// ---------------- Polígonos convexos ----------------
+// Cobertura = distancia (con signo) a la arista más cercana + 1/2. Como cada
+// distancia es lineal en x, el tramo interior (todas >= 1/2) y el exterior
+// (todas > -1/2) de una fila se obtienen intersecando semirrectas.
+void fillConvex(const PixelBuffer &buf, const double *xs, const double *ys,
+                size_t n, uint32_t color) {
+  if (n < 3)
+    return;
+
+  // Orientación por el área con signo
+  double area = 0.0;
+  for (size_t i = 0, j = n - 1; i < n; j = i++)
+    area += xs[j] * ys[i] - xs[i] * ys[j];
+  if (std::abs(area) < 1e-12)
+    return;
+  const double s = area > 0 ? 1.0 : -1.0;
+
+  // Box2D limita los polígonos a 8 vértices: casi nunca se usa el heap
+  Edge local[16];
+  std::vector<Edge> heap;
+  Edge *edges = local;
+  if (n > std::size(local)) {
+    heap.resize(n);
+    edges = heap.data();
+  }
+  size_t ne = 0;
+  double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    minX = std::min(minX, xs[i]);
+    maxX = std::max(maxX, xs[i]);
+    minY = std::min(minY, ys[i]);
+    maxY = std::max(maxY, ys[i]);
+    const double ex = xs[i] - xs[j], ey = ys[i] - ys[j];
+    const double len = std::hypot(ex, ey);
+    if (len == 0.0)
+      continue;
+    edges[ne++] = {-s * ey / len, s * ex / len,
+                   s * (ey * xs[j] - ex * ys[j]) / len};
+  }
+
+  const int xLo = std::max(buf.x0, firstCentre(minX - 0.5));
+  const int xHi = std::min(buf.x0 + buf.width - 1, lastCentre(maxX + 0.5));
+  const int yBeg = std::max(buf.y0, firstCentre(minY - 0.5));
+  const int yEnd = std::min(buf.y0 + buf.height - 1, lastCentre(maxY + 0.5));
+
+  for (int y = yBeg; y <= yEnd; ++y) {
+    const double py = y + 0.5;
+    double outLo = minX - 0.5, outHi = maxX + 0.5;
+    double inLo = outLo, inHi = outHi;
+    bool inner = true;
+    for (size_t k = 0; k < ne; ++k) {
+      const Edge &e = edges[k];
+      const double base = e.b * py + e.c; // d = a*x + base
+      if (e.a > 0) {
+        outLo = std::max(outLo, (-0.5 - base) / e.a);
+        inLo = std::max(inLo, (0.5 - base) / e.a);
+      } else if (e.a < 0) {
+        outHi = std::min(outHi, (-0.5 - base) / e.a);
+        inHi = std::min(inHi, (0.5 - base) / e.a);
+      } else {
+        if (base <= -0.5)
+          outHi = outLo - 1.0;
+        if (base < 0.5)
+          inner = false;
+      }
+    }
+
+    const int xa = std::max(xLo, firstCentre(outLo));
+    const int xb = std::min(xHi, lastCentre(outHi));
+    if (xa > xb)
+      continue;
+    int ia = xb + 1, ib = xb;
+    if (inner && inLo <= inHi) {
+      ia = std::max(xa, firstCentre(inLo));
+      ib = std::min(xb, lastCentre(inHi));
+      if (ia > ib) {
+        ia = xb + 1;
+        ib = xb;
+      }
+    }
+
+    uint32_t *row = buf.row(y);
+    auto edge = [&](int x) {
+      const double px = x + 0.5;
+      double d = 1e300;
+      for (size_t k = 0; k < ne; ++k)
+        d = std::min(d, edges[k].a * px + edges[k].b * py + edges[k].c);
+      blendPixel(row + x, color, d + 0.5);
+    };
+    for (int x = xa; x < ia; ++x)
+      edge(x);
+    if (ia <= ib)
+      fillSpan(row + ia, static_cast<size_t>(ib - ia + 1), color);
+    for (int x = std::max(ib + 1, ia); x <= xb; ++x)
+      edge(x);
+  }
+}
+
+} // namespace SoftRaster
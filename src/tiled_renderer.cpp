@@ -0,0 +1,170 @@
+#include "tiled_renderer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Margen de la región de un tile: antialiasing y medio ancho de línea de las
+// paredes
+constexpr double kPad = 2.0;
+
+} // namespace
+
+struct TiledRenderer::Worker {
+  Renderer renderer;
+  Canvas canvas;
+  GrainSelection selection;
+  GrainStore grains; // los granos del tile
+
+  Worker(const RenderSettings &s, int tile)
+      : renderer(s.width, s.height, s.margin, s.valmin, s.valmax, s.backend,
+                 s.batched, s.lod),
+        canvas(tile, tile) {}
+};
+
+TiledRenderer::TiledRenderer(const RenderSettings &settings, size_t threads)
+    : settings_(settings), tile_(std::max(settings.tile, 16)),
+      rows_((settings.height + tile_ - 1) / tile_),
+      cols_((settings.width + tile_ - 1) / tile_),
+      toScreen_(ScreenTransform::fit(settings.width, settings.height,
+                                     settings.margin, settings.xmin,
+                                     settings.xmax, settings.ymin,
+                                     settings.ymax)),
+      idle_(std::max<size_t>(threads, 1)), pool_(std::max<size_t>(threads, 1)) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>(settings_, tile_));
+    idle_.push(workers_.back().get());
+  }
+  // Franjas en vuelo: las que hacen falta para ocupar todos los hilos, más
+  // la que se está comprimiendo
+  const size_t ahead = std::max<size_t>(
+      2, (threads + static_cast<size_t>(cols_) - 1) / cols_ + 1);
+  strips_.resize(ahead);
+}
+
+TiledRenderer::~TiledRenderer() { drain(); }
+
+// ---------------- Un tile ----------------
+void TiledRenderer::drawTile(Worker &worker, const GrainStore &grains,
+                             const GrainIndex &index, int strip, int col,
+                             Strip &out) {
+  const int x0 = col * tile_, y0 = strip * tile_;
+  const int w = std::min(tile_, settings_.width - x0);
+  const int h = std::min(tile_, settings_.height - y0);
+
+  // Copia de los granos que tocan el tile, en el orden original
+  const GrainBox region{toScreen_.wx(x0 - kPad), toScreen_.wy(y0 + h + kPad),
+                        toScreen_.wx(x0 + w + kPad), toScreen_.wy(y0 - kPad)};
+  index.query(region, worker.selection);
+  copySelection(grains, worker.selection, worker.grains);
+
+  const RenderSettings &s = settings_;
+  worker.renderer.renderTile(worker.canvas, x0, y0, worker.grains, s.xmin,
+                             s.xmax, s.ymin, s.ymax, s.cmap);
+
+  cairo_surface_t *surface = worker.canvas.surface();
+  const unsigned char *src = cairo_image_surface_get_data(surface);
+  const int stride = cairo_image_surface_get_stride(surface);
+  for (int y = 0; y < h; ++y)
+    std::memcpy(out.pixels.data() + static_cast<size_t>(y) * s.width + x0,
+                src + static_cast<size_t>(y) * stride,
+                static_cast<size_t>(w) * 4);
+}
+
+void TiledRenderer::submit(const GrainStore &grains, const GrainIndex &index,
+                           int strip) {
+  Strip &st = strips_[strip % strips_.size()];
+  st.tiles.clear();
+  for (int col = 0; col < cols_; ++col) {
+    st.tiles.push_back(pool_.enqueue([this, &grains, &index, &st, strip,
+                                      col] {
+      Worker *worker = nullptr;
+      idle_.pop(worker);
+      try {
+        drawTile(*worker, grains, index, strip, col, st);
+      } catch (...) {
+        idle_.push(worker);
+        throw;
+      }
+      idle_.push(worker);
+    }));
+  }
+}
+
+// Espera todas las tareas en vuelo (que usan las franjas y los granos)
+void TiledRenderer::drain() {
+  for (Strip &st : strips_) {
+    for (auto &f : st.tiles)
+      if (f.valid())
+        f.wait();
+    st.tiles.clear();
+    if (st.packed.valid())
+      st.packed.wait();
+    st.packed = {};
+  }
+}
+
+// ---------------- Frame completo ----------------
+bool TiledRenderer::render(const GrainStore &grains, const GrainIndex &index,
+                           const std::string &filename) {
+  const int width = settings_.width, height = settings_.height;
+  PngStripFile file(settings_.encode, filename, width, height);
+  if (!file.valid())
+    return false;
+
+  for (Strip &st : strips_) {
+    st.pixels.resize(static_cast<size_t>(width) * tile_);
+    st.prev.resize(width);
+  }
+
+  const int ahead = static_cast<int>(strips_.size());
+  bool ok = true;
+  try {
+    for (int s = 0; s < std::min(ahead, rows_); ++s)
+      submit(grains, index, s);
+
+    for (int s = 0; s < rows_; ++s) {
+      Strip &st = strips_[s % ahead];
+      for (auto &f : st.tiles)
+        f.get();
+      st.tiles.clear();
+
+      // La franja anterior sigue en el anillo hasta que se escribe
+      const bool first = s == 0, last = s == rows_ - 1;
+      if (!first) {
+        const Strip &before = strips_[(s - 1) % ahead];
+        std::memcpy(st.prev.data(),
+                    before.pixels.data() +
+                        static_cast<size_t>(tile_ - 1) * width,
+                    static_cast<size_t>(width) * 4);
+      }
+      ImageView rows;
+      rows.data = st.pixels.data();
+      rows.width = width;
+      rows.height = std::min(tile_, height - s * tile_);
+      rows.stride = width;
+      st.packed = pool_.enqueue([this, &st, rows, first, last] {
+        st.png.compress(settings_.encode, rows,
+                        first ? nullptr : st.prev.data(), last);
+      });
+
+      if (!first) {
+        Strip &done = strips_[(s - 1) % ahead];
+        done.packed.get();
+        ok = file.append(done.png) && ok;
+        if (s - 1 + ahead < rows_)
+          submit(grains, index, s - 1 + ahead);
+      }
+    }
+    Strip &tail = strips_[(rows_ - 1) % ahead];
+    tail.packed.get();
+    ok = file.append(tail.png) && ok;
+  } catch (...) {
+    drain();
+    throw;
+  }
+  return file.finish() && ok;
+}
@@ -0,0 +1,104 @@
+#include "value_table.hpp"
+#include "frame_binary.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Un gid se guarda en la parte densa mientras no deje más de este número
+// de huecos por fila existente (ids "casi" densos siguen siendo densos)
+constexpr size_t kMaxGapFactor = 4;
+constexpr size_t kMinDense = 1024;
+} // namespace
+
+void ValueTable::set(int gid, std::span<const double> row) {
+  const bool exists = contains(gid);
+
+  const bool denseCandidate =
+      gid >= 0 && (static_cast<size_t>(gid) < len_.size() ||
+                   static_cast<size_t>(gid) <
+                       std::max(kMinDense, kMaxGapFactor * (rows_ + 1)));
+  if (!denseCandidate) {
+    auto &slot = sparseIndex_[gid];
+    slot = {static_cast<uint32_t>(sparse_.size()),
+            static_cast<uint32_t>(row.size())};
+    sparse_.insert(sparse_.end(), row.begin(), row.end());
+    if (!exists)
+      ++rows_;
+    return;
+  }
+
+  if (row.size() > stride_)
+    restride(row.size());
+  const size_t g = static_cast<size_t>(gid);
+  if (g >= len_.size()) {
+    // Crecimiento geométrico: O(1) amortizado por fila
+    const size_t n = std::max(g + 1, len_.size() * 2);
+    len_.resize(n, -1);
+    dense_.resize(n * stride_, 0.0);
+  }
+  std::copy(row.begin(), row.end(), dense_.begin() + g * stride_);
+  len_[g] = static_cast<int32_t>(row.size());
+
+  if (exists && sparseIndex_.erase(gid) == 0)
+    return; // ya era una fila densa
+  if (!exists)
+    ++rows_;
+}
+
+bool ValueTable::contains(int gid) const {
+  if (gid >= 0 && static_cast<size_t>(gid) < len_.size() && len_[gid] >= 0)
+    return true;
+  return sparseIndex_.count(gid) != 0;
+}
+
+std::span<const double> ValueTable::findSparse(int gid) const {
+  auto it = sparseIndex_.find(gid);
+  if (it == sparseIndex_.end())
+    return {};
+  return {sparse_.data() + it->second.first, it->second.second};
+}
+
+void ValueTable::reserve(size_t n, size_t stride) {
+  if (stride > stride_)
+    restride(stride);
+  len_.reserve(n);
+  dense_.reserve(n * std::max<size_t>(stride_, 1));
+}
+
+void ValueTable::clear() {
+  // Conserva la capacidad para reutilizar la tabla en el próximo frame
+  rows_ = 0;
+  dense_.clear();
+  len_.clear();
+  sparseIndex_.clear();
+  sparse_.clear();
+}
+
+void ValueTable::restride(size_t stride) {
+  // Caso raro (una fila más larga que las anteriores): se reubican las filas
+  std::pmr::vector<double> wider(len_.size() * stride, 0.0,
+                                 dense_.get_allocator());
+  for (size_t g = 0; g < len_.size(); g++)
+    if (len_[g] > 0)
+      std::memcpy(wider.data() + g * stride, dense_.data() + g * stride_,
+                  static_cast<size_t>(len_[g]) * sizeof(double));
+  dense_.swap(wider);
+  stride_ = stride;
+}
+
+ValueTable ValueTable::fromColumns(const ValueColumns &cols,
+                                   std::pmr::memory_resource *mem) {
+  ValueTable t(mem);
+  if (cols.empty())
+    return t;
+  size_t stride = 0;
+  for (size_t i = 0; i < cols.rows(); i++)
+    stride = std::max<size_t>(stride, cols.offset[i + 1] - cols.offset[i]);
+  t.reserve(cols.rows(), stride);
+  for (size_t i = 0; i < cols.rows(); i++)
+    t.set(cols.gid[i],
+          std::span<const double>(cols.values.data() + cols.offset[i],
+                                  cols.offset[i + 1] - cols.offset[i]));
+  return t;
+}